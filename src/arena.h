@@ -0,0 +1,86 @@
+/**
+ * @file arena.h
+ * @brief Reusable scratch arena for per-line and per-batch temporaries, built on std::pmr.
+ *
+ * Solvers that need short-lived containers for each line (or update, or equation) take them from a ScratchArena
+ * through a std::pmr allocator, and reset the arena between lines. Allocating is a pointer bump into a buffer the
+ * arena keeps, and resetting rewinds it, so the steady state makes no calls to the global heap. If a round outgrows
+ * the buffer, the overflow comes from the heap and the buffer grows at the next reset, so later rounds fit again.
+ *
+ * An arena is not thread-safe: give each worker thread its own (e.g. thread_local), which also keeps threads from
+ * contending on the global allocator.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief A monotonic std::pmr arena over a retained buffer, rewound between rounds of scratch work.
+ */
+class ScratchArena {
+public:
+    /**
+     * @brief Constructs a ScratchArena object.
+     *
+     * @param initial_bytes The starting size of the buffer.
+     */
+    explicit ScratchArena(size_t initial_bytes = 4096) : buffer_(initial_bytes) {
+        arena_.emplace(buffer_.data(), buffer_.size(), &overflow_);
+    }
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    /**
+     * @brief Returns the memory resource to build scratch containers on (e.g. std::pmr::vector<int> v(arena.resource())).
+     */
+    std::pmr::memory_resource* resource() {
+        return &*arena_;
+    }
+
+    /**
+     * @brief Frees everything allocated since the last reset. Containers built on the arena must be gone by then.
+     */
+    void reset() {
+        arena_.reset();
+
+        // Grow the buffer to cover the last round's overflow, so the next round stays off the heap
+        if (overflow_.bytes > 0) {
+            buffer_.resize(buffer_.size() + overflow_.bytes);
+            overflow_.bytes = 0;
+        }
+
+        arena_.emplace(buffer_.data(), buffer_.size(), &overflow_);
+    }
+
+private:
+    /**
+     * @brief Upstream resource for when the buffer runs out: allocates from the heap and counts the bytes.
+     */
+    struct OverflowResource : std::pmr::memory_resource {
+        size_t bytes = 0;
+
+        void* do_allocate(size_t size, size_t alignment) override {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+
+        void do_deallocate(void* ptr, size_t size, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(ptr, size, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    std::vector<std::byte> buffer_;
+    OverflowResource overflow_;
+    std::optional<std::pmr::monotonic_buffer_resource> arena_;
+};
+
+#endif
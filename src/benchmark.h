@@ -0,0 +1,348 @@
+/**
+ * @file benchmark.h
+ * @brief Per-phase timing, allocation counting and regression checks shared by the daily solutions.
+ *
+ * Each day's main wraps its phases (parsing, part one, part two, ...) in Benchmark::phase. Normally every phase
+ * runs once, as before. When the program is started with --bench, every phase is repeated, and the median time,
+ * spread and allocation count of each phase are written to a results file. If a baseline file is given, the run is
+ * compared against it and the program exits non-zero when a phase got slower (or allocates more) than the noise
+ * allows.
+ *
+ * Command line options:
+ * - --bench [runs]: Repeat every phase this many times (10 by default) and record the results.
+ * - --results <file>: Where to record the results (benchmark.txt by default). Entries for other days are kept.
+ * - --baseline <file>: Results file of a previous run to compare against.
+ * - --threshold <percent>: Allowed slowdown of the median on top of the measured noise (10 by default).
+ *
+ * Results files hold one line per phase: "<day> <phase> <runs> <median ns> <spread ns> <allocations> <allocation
+ * spread>", where the spreads are the median absolute deviations over the runs and allocations are counted per run.
+ * Allocation counts can vary between runs too (e.g. when the work a thread pool splits off depends on timing), so
+ * they are compared against the spread in the same way as times.
+ *
+ * This header replaces the global operator new to count allocations, so it must be included by exactly one
+ * translation unit per program (each day is a single file, so include it from the day's .cpp). Allocations are only
+ * counted with --bench, and each thread counts into its own cache line, so threads don't contend on a shared counter.
+ */
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief One thread's allocation counter, padded to a cache line of its own.
+ */
+struct alignas(64) AllocationSlot {
+    std::atomic<size_t> count{0};
+};
+
+constexpr size_t allocation_slot_count = 64;  // Threads beyond this share slots, which stays correct
+
+std::atomic<bool> allocation_counting{false};  // Set by Benchmark when started with --bench
+std::atomic<size_t> allocation_next_slot{0};
+AllocationSlot allocation_slots[allocation_slot_count];
+
+/**
+ * @brief Returns the number of allocations counted so far, over all threads.
+ */
+inline size_t allocation_count() {
+    size_t total = 0;
+    for (const AllocationSlot& slot : allocation_slots) {
+        total += slot.count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// Kept out of line, so GCC doesn't pair the inlined malloc/free with new/delete and warn (-Wmismatched-new-delete)
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    if (allocation_counting.load(std::memory_order_relaxed)) {
+        thread_local size_t slot = allocation_next_slot.fetch_add(1, std::memory_order_relaxed) % allocation_slot_count;
+        allocation_slots[slot].count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+/**
+ * @brief Timing and allocation statistics of one phase over repeated runs.
+ */
+struct PhaseStats {
+    size_t runs = 0;
+    double median_ns = 0;
+    double spread_ns = 0;
+    size_t allocations = 0;
+    size_t allocation_spread = 0;
+};
+
+/**
+ * @brief Times the phases of a day's solution and checks them against a stored baseline.
+ */
+class Benchmark {
+public:
+    /**
+     * @brief Constructs a Benchmark object, reading its options from the command line.
+     *
+     * Unknown arguments are ignored, so days can keep their own options.
+     *
+     * @param day The name of the day (e.g. "day6"), used as the key in results files.
+     * @param argc The argument count passed to main.
+     * @param argv The arguments passed to main.
+     */
+    Benchmark(std::string day, int argc, char* argv[])
+        : day_(std::move(day)), runs_(1), enabled_(false), results_path_("benchmark.txt"), threshold_(10.0) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+
+            if (arg == "--bench") {
+                enabled_ = true;
+                runs_ = 10;
+                if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                    runs_ = std::max(1, std::atoi(argv[++i]));
+                }
+            } else if (arg == "--results" && i + 1 < argc) {
+                results_path_ = argv[++i];
+            } else if (arg == "--baseline" && i + 1 < argc) {
+                baseline_path_ = argv[++i];
+            } else if (arg == "--threshold" && i + 1 < argc) {
+                threshold_ = std::atof(argv[++i]);
+            }
+        }
+
+        allocation_counting.store(enabled_, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Runs one phase of the solution, repeating and timing it when benchmarking.
+     *
+     * Output to std::cout is suppressed for every run but the last, so the answers are printed once.
+     *
+     * @param name The name of the phase (e.g. "parse", "part_one").
+     * @param fn The phase. It must not depend on state changed by an earlier run of itself.
+     * @return The result of the last run of fn.
+     */
+    template <typename F>
+    auto phase(const std::string& name, F fn) {
+        std::vector<double> times;
+        std::vector<size_t> allocations;
+        std::streambuf* out = std::cout.rdbuf();
+
+        for (int run = 1; run < runs_; run++) {
+            std::cout.rdbuf(nullptr);
+            measure(fn, times, allocations);
+            std::cout.rdbuf(out);
+            std::cout.clear();
+        }
+
+        // The last run is kept outside the loop so its result can be returned
+        auto start = std::chrono::steady_clock::now();
+        size_t start_allocations = allocation_count();
+
+        if constexpr (std::is_void_v<decltype(fn())>) {
+            fn();
+            record(name, start, start_allocations, times, allocations);
+        } else {
+            auto result = fn();
+            record(name, start, start_allocations, times, allocations);
+            return result;
+        }
+    }
+
+    /**
+     * @brief Returns true if the program was started with --bench.
+     */
+    bool enabled() const {
+        return enabled_;
+    }
+
+    /**
+     * @brief Writes the results and compares them against the baseline, when benchmarking.
+     *
+     * @return int The exit status for main: 1 if a phase regressed against the baseline, 0 otherwise.
+     */
+    int finish() {
+        if (!enabled_) {
+            return 0;
+        }
+
+        write_results();
+
+        if (baseline_path_.empty()) {
+            return 0;
+        }
+
+        std::map<std::pair<std::string, std::string>, PhaseStats> baseline = read_results(baseline_path_);
+        bool regressed = false;
+
+        std::cout << "Benchmark " << day_ << " vs " << baseline_path_ << ":" << std::endl;
+
+        for (const auto& [name, stats] : phases_) {
+            auto base = baseline.find({day_, name});
+            if (base == baseline.end()) {
+                std::cout << "  " << name << ": no baseline" << std::endl;
+                continue;
+            }
+
+            const PhaseStats& old_stats = base->second;
+
+            // Slower than the threshold allows on top of the noise of both runs
+            double allowed_ns = old_stats.median_ns * threshold_ / 100.0 + 3.0 * (old_stats.spread_ns + stats.spread_ns) + min_delta_ns;
+            bool slower = stats.median_ns > old_stats.median_ns + allowed_ns;
+
+            // Allocates more than the noise of both runs allows (any increase when both were steady)
+            size_t allowed_allocations = 3 * (old_stats.allocation_spread + stats.allocation_spread);
+            bool more_allocations = stats.allocations > old_stats.allocations + allowed_allocations;
+            double change = (old_stats.median_ns > 0) ? 100.0 * (stats.median_ns / old_stats.median_ns - 1.0) : 0.0;
+
+            std::cout << "  " << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(3)
+                      << format_ms(old_stats.median_ns) << " -> " << format_ms(stats.median_ns) << " ms ("
+                      << std::showpos << std::setprecision(1) << change << "%" << std::noshowpos << "), allocations "
+                      << old_stats.allocations << " -> " << stats.allocations;
+
+            if (slower || more_allocations) {
+                std::cout << "  REGRESSION";
+                regressed = true;
+            }
+            std::cout << std::endl;
+        }
+
+        return regressed ? 1 : 0;
+    }
+
+private:
+    template <typename F>
+    void measure(F& fn, std::vector<double>& times, std::vector<size_t>& allocations) {
+        auto start = std::chrono::steady_clock::now();
+        size_t start_allocations = allocation_count();
+
+        fn();
+
+        // Read both before pushing, so the vectors' own growth isn't counted
+        double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        size_t allocated = allocation_count() - start_allocations;
+        times.push_back(elapsed_ns);
+        allocations.push_back(allocated);
+    }
+
+    void record(const std::string& name, std::chrono::steady_clock::time_point start, size_t start_allocations,
+                std::vector<double>& times, std::vector<size_t>& allocations) {
+        double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        size_t allocated = allocation_count() - start_allocations;
+        times.push_back(elapsed_ns);
+        allocations.push_back(allocated);
+
+        if (!enabled_) {
+            return;
+        }
+
+        PhaseStats stats;
+        stats.runs = times.size();
+        stats.median_ns = median(times);
+        stats.allocations = median(allocations);
+
+        std::vector<double> deviations;
+        for (double t : times) {
+            deviations.push_back(std::abs(t - stats.median_ns));
+        }
+        stats.spread_ns = median(deviations);
+
+        std::vector<size_t> allocation_deviations;
+        for (size_t count : allocations) {
+            allocation_deviations.push_back((count > stats.allocations) ? count - stats.allocations : stats.allocations - count);
+        }
+        stats.allocation_spread = median(allocation_deviations);
+
+        phases_.push_back({name, stats});
+    }
+
+    template <typename T>
+    static T median(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        size_t mid = values.size() / 2;
+        return (values.size() % 2 == 1) ? values[mid] : values[mid - 1] + (values[mid] - values[mid - 1]) / 2;
+    }
+
+    static std::string format_ms(double ns) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(3) << ns / 1e6;
+        return oss.str();
+    }
+
+    static std::map<std::pair<std::string, std::string>, PhaseStats> read_results(const std::string& path) {
+        std::map<std::pair<std::string, std::string>, PhaseStats> results;
+        std::ifstream file(path);
+        std::string line;
+
+        while (std::getline(file, line)) {
+            std::istringstream iss(line);
+            std::string day;
+            std::string name;
+            PhaseStats stats;
+
+            if (iss >> day >> name >> stats.runs >> stats.median_ns >> stats.spread_ns >> stats.allocations) {
+                iss >> stats.allocation_spread;  // Missing from older results files, where it stays 0
+                results[{day, name}] = stats;
+            }
+        }
+
+        return results;
+    }
+
+    /**
+     * @brief Replaces this day's entries in the results file, keeping the other days.
+     */
+    void write_results() {
+        std::map<std::pair<std::string, std::string>, PhaseStats> results = read_results(results_path_);
+
+        for (auto it = results.begin(); it != results.end();) {
+            it = (it->first.first == day_) ? results.erase(it) : std::next(it);
+        }
+        for (const auto& [name, stats] : phases_) {
+            results[{day_, name}] = stats;
+        }
+
+        std::ofstream file(results_path_);
+        file << std::fixed << std::setprecision(0);
+        for (const auto& [key, stats] : results) {
+            file << key.first << " " << key.second << " " << stats.runs << " " << stats.median_ns << " "
+                 << stats.spread_ns << " " << stats.allocations << " " << stats.allocation_spread << "\n";
+        }
+    }
+
+    static constexpr double min_delta_ns = 1000.0;  // Ignore differences below a microsecond
+
+    std::string day_;
+    int runs_;
+    bool enabled_;
+    std::string results_path_;
+    std::string baseline_path_;
+    double threshold_;
+    std::vector<std::pair<std::string, PhaseStats>> phases_;
+};
+
+#endif
@@ -4,25 +4,30 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <span>
+#include <array>
+
+#include "benchmark.h"
+#include "input_cache.h"
+#include "service.h"
 
 /**
  * @brief Computes the distance between two lists by summing the absolute differences of their sorted elements.
  * 
- * This function sorts both input lists and then iterates through their elements, summing the absolute differences
- * between corresponding elements from the two lists. The result is a measure of how different the two lists are.
+ * This function iterates through the elements of both sorted lists, summing the absolute differences between
+ * corresponding elements from the two lists. The result is a measure of how different the two lists are.
+ * The lists are sorted once when they are loaded, so this makes no allocations, and it can run at compile time.
  * 
- * @param list_one The first list of integers.
- * @param list_two The second list of integers.
+ * @param list_one The first list of integers, sorted.
+ * @param list_two The second list of integers, sorted.
  * @return The total distance, which is the sum of the absolute differences between corresponding elements of the sorted lists.
  */
-int list_distance(std::vector<int> list_one, std::vector<int> list_two) {
+constexpr int list_distance(std::span<const int> list_one, std::span<const int> list_two) {
     int distance = 0;
-
-    std::sort(list_one.begin(), list_one.end());
-    std::sort(list_two.begin(), list_two.end());
     
     for (size_t i = 0; i < list_one.size() && i < list_two.size(); ++i) {
-        distance += abs(list_one[i] - list_two[i]);
+        int diff = list_one[i] - list_two[i];
+        distance += (diff < 0) ? -diff : diff;
     }
     return distance;
 }
@@ -37,7 +42,7 @@ int list_distance(std::vector<int> list_one, std::vector<int> list_two) {
  * @param list_two The second list of integers.
  * @return The similarity score, which is the sum of the values that are present in both lists.
  */
-int list_similarity(std::vector<int> list_one, std::vector<int> list_two) {
+constexpr int list_similarity(std::span<const int> list_one, std::span<const int> list_two) {
     int similarity = 0;
 
     for (size_t i = 0; i < list_one.size(); i++) {
@@ -51,20 +56,25 @@ int list_similarity(std::vector<int> list_one, std::vector<int> list_two) {
     return similarity;
 }
 
+// Golden checks on the puzzle's example lists, solved at compile time
+static_assert([] {
+    std::array<int, 6> list_one = {3, 4, 2, 1, 3, 3};
+    std::array<int, 6> list_two = {4, 3, 5, 3, 9, 3};
+    std::sort(list_one.begin(), list_one.end());
+    std::sort(list_two.begin(), list_two.end());
+    return list_distance(list_one, list_two) == 11 && list_similarity(list_one, list_two) == 31;
+}());
+
 /**
- * @brief Entry point of the program.
+ * @brief Reads the two location lists from a file, one pair of integers per line.
  *
- * This function reads pairs of integers from a file named "data/day1.txt",
- * stores them in two separate lists, calculates the distance and similarity
- * between the two lists, and prints the results to the standard output.
- *
- * @return int Exit status of the program.
+ * @param path The path to the input file.
+ * @return std::vector<std::vector<int>> The two lists, each sorted (as list_distance expects).
  */
-int main() {
-
+std::vector<std::vector<int>> read_location_lists(const std::string& path) {
     std::vector<std::vector<int>> lists = {{}, {}};
 
-    std::ifstream file("../data/day1.txt");
+    std::ifstream file(path);
     std::string line;
 
     while (std::getline(file, line)) {
@@ -75,11 +85,71 @@ int main() {
         }
     }
 
-    int distance = list_distance(lists[0], lists[1]);
-    int similarity = list_similarity(lists[0], lists[1]);
+    for (std::vector<int>& list : lists) {
+        std::sort(list.begin(), list.end());
+    }
+
+    return lists;
+}
+
+/**
+ * @brief Loads the two location lists from the binary cache, or parses the text and writes the cache (see input_cache.h).
+ * 
+ * The cache holds the two sorted lists as int columns. They are sorted again on decode (which is cheap on sorted
+ * data), so list_distance can rely on it whatever the cache holds.
+ */
+std::vector<std::vector<int>> load_location_lists(const std::string& path, bool use_cache) {
+    return load_cached(path, "day1", use_cache, read_location_lists,
+                       [](const std::vector<std::vector<int>>& lists, CacheWriter& writer) {
+                           writer.put_array(lists[0]);
+                           writer.put_array(lists[1]);
+                       },
+                       [](CacheReader& reader) {
+                           std::span<const int> list_one = reader.get_array<int>();
+                           std::span<const int> list_two = reader.get_array<int>();
+                           std::vector<std::vector<int>> lists = {{list_one.begin(), list_one.end()}, {list_two.begin(), list_two.end()}};
+                           for (std::vector<int>& list : lists) {
+                               std::sort(list.begin(), list.end());
+                           }
+                           return lists;
+                       });
+}
+
+/**
+ * @brief Entry point of the program.
+ *
+ * This function reads pairs of integers from a file named "data/day1.txt",
+ * stores them in two separate lists, calculates the distance and similarity
+ * between the two lists, and prints the results to the standard output.
+ * Pass --bench to time each phase (see benchmark.h), or --serve / --query to
+ * keep the lists loaded in a resident service (see service.h). Parsed lists are cached
+ * next to the input (see input_cache.h); pass --no-cache to always parse the text.
+ *
+ * @return int Exit status of the program.
+ */
+int main(int argc, char* argv[]) {
+    const std::string input_path = "../data/day1.txt";
+    bool use_cache = cache_enabled(argc, argv);
+    auto load = [use_cache](const std::string& path) { return load_location_lists(path, use_cache); };
+
+    int status;
+    if (run_service("day1", input_path, argc, argv, load,
+                    [](std::vector<std::vector<int>>& lists, int part) {
+                        return std::to_string((part == 1) ? list_distance(lists[0], lists[1])
+                                                          : list_similarity(lists[0], lists[1]));
+                    }, status)) {
+        return status;
+    }
+
+    Benchmark bench("day1", argc, argv);
+
+    std::vector<std::vector<int>> lists = bench.phase("parse", [&] { return load(input_path); });
+
+    int distance = bench.phase("distance", [&] { return list_distance(lists[0], lists[1]); });
+    int similarity = bench.phase("similarity", [&] { return list_similarity(lists[0], lists[1]); });
 
     std::cout << "Total distance: " << distance << std::endl;
     std::cout << "Similarity: " << similarity << std::endl;
     
-    return 0;
-}
\ No newline at end of file
+    return bench.finish();
+}
@@ -2,30 +2,78 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <string_view>
+#include <span>
+#include <array>
+#include <ranges>
+
+#include "benchmark.h"
+#include "input_cache.h"
+#include "service.h"
+
+/**
+ * @brief Reads the next whitespace-separated integer from the front of a string, consuming it.
+ * 
+ * @param text The remaining text, advanced past the integer.
+ * @param level Set to the integer that was read.
+ * @return true If an integer was read.
+ * @return false If the text holds no more integers.
+ */
+constexpr bool read_level(std::string_view& text, int& level) {
+    size_t pos = 0;
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r')) {
+        pos++;
+    }
+
+    bool negative = (pos < text.size() && text[pos] == '-');
+    if (negative) {
+        pos++;
+    }
+
+    if (pos >= text.size() || text[pos] < '0' || text[pos] > '9') {
+        return false;
+    }
+
+    level = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        level = level * 10 + (text[pos] - '0');
+        pos++;
+    }
+    if (negative) {
+        level = -level;
+    }
+
+    text.remove_prefix(pos);
+    return true;
+}
 
 /**
  * @brief Checks if a given report is safe based on the specified criteria.
  * 
  * A report is considered safe if the difference between consecutive levels is not zero 
  * and does not exceed 3, and the sequence of levels is either strictly increasing or 
- * strictly decreasing. The function allows for a specified number of problems (default is 1).
+ * strictly decreasing. The function allows for a specified number of problems.
+ * The levels are pulled one at a time from a callback, so reports can be read from text or from parsed levels.
  * 
- * @param report The report string containing space-separated levels.
- * @param max_problems The maximum number of problems allowed for the report to be considered safe (default is 1).
+ * @tparam NextLevel Callable as bool(int& level), returning false once the report has no more levels.
+ * @param next_level Reads the next level of the report.
+ * @param max_problems The maximum number of problems allowed for the report to be considered safe.
  * @return true If the report is safe.
  * @return false If the report is not safe.
  */
-bool is_safe_report(std::string report, int max_problems = 1) {
-    std::istringstream iss(report);
-    int curr_level;
-    int prev_level;
+template <typename NextLevel>
+constexpr bool is_safe_levels(NextLevel next_level, int max_problems) {
+    int curr_level = 0;
+    int prev_level = 0;
     int diff;
     int problem_count = 0;
     bool found_problem;
 
-    iss >> prev_level;
-    iss >> curr_level;
-    diff = abs(curr_level - prev_level);
+    if (!next_level(prev_level) || !next_level(curr_level)) {
+        return true;  // Fewer than two levels can't be unsafe
+    }
+    diff = (curr_level > prev_level) ? curr_level - prev_level : prev_level - curr_level;
 
     if (diff == 0 || diff > 3) {
         problem_count++;
@@ -38,8 +86,8 @@ bool is_safe_report(std::string report, int max_problems = 1) {
     bool is_increasing = (curr_level > prev_level);
     prev_level = curr_level;
 
-    while (iss >> curr_level) {
-        diff = abs(curr_level - prev_level);
+    while (next_level(curr_level)) {
+        diff = (curr_level > prev_level) ? curr_level - prev_level : prev_level - curr_level;
 
         found_problem = ((diff == 0 || diff > 3) || 
                          (is_increasing && (curr_level < prev_level)) || 
@@ -59,20 +107,147 @@ bool is_safe_report(std::string report, int max_problems = 1) {
     return true;
 }
 
-// Count and return the number of safe reports in the data file
-int main() {
-    std::ifstream file("../data/day2.txt");
+/**
+ * @brief Checks if a report given as text is safe (see is_safe_levels).
+ * 
+ * The report is read in place (no copies are made), and the function can run at compile time.
+ * 
+ * @param report The report string containing space-separated levels.
+ * @param max_problems The maximum number of problems allowed for the report to be considered safe (default is 1).
+ */
+constexpr bool is_safe_report(std::string_view report, int max_problems = 1) {
+    return is_safe_levels([&](int& level) { return read_level(report, level); }, max_problems);
+}
+
+/**
+ * @brief Checks if a report given as parsed levels is safe (see is_safe_levels).
+ * 
+ * @param levels The levels of the report.
+ * @param max_problems The maximum number of problems allowed for the report to be considered safe (default is 1).
+ */
+constexpr bool is_safe_report(std::span<const int> levels, int max_problems = 1) {
+    size_t next = 0;
+    return is_safe_levels([&](int& level) {
+        if (next == levels.size()) {
+            return false;
+        }
+        level = levels[next++];
+        return true;
+    }, max_problems);
+}
+
+// Golden checks on the puzzle's example reports, solved at compile time
+static_assert(is_safe_report("7 6 4 2 1", 0) && is_safe_report("1 3 6 7 9", 0));
+static_assert(!is_safe_report("1 2 7 8 9", 0) && !is_safe_report("9 7 6 2 1", 0));
+static_assert(!is_safe_report("1 3 2 4 5", 0) && !is_safe_report("8 6 4 4 1", 0));
+static_assert([] {
+    std::array<int, 5> levels = {1, 3, 2, 4, 5};
+    return !is_safe_report(levels, 0) && is_safe_report(levels, 1);
+}());
+
+/**
+ * @brief The parsed reports, stored CSR-style: report i holds levels[offsets[i] .. offsets[i+1]).
+ */
+struct Reports {
+    std::vector<size_t> offsets = {0};
+    std::vector<int> levels;
+
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+
+    std::span<const int> report(size_t i) const {
+        return std::span<const int>(levels).subspan(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+};
+
+/**
+ * @brief Reads the reports from a file, one per line.
+ * 
+ * @param path The path to the input file.
+ * @return Reports The levels of every report.
+ */
+Reports read_reports(const std::string& path) {
+    std::ifstream file(path);
     std::string line;
+    Reports reports;
+
+    while (std::getline(file, line)) {
+        std::string_view text = line;
+        int level;
 
+        while (read_level(text, level)) {
+            reports.levels.push_back(level);
+        }
+        reports.offsets.push_back(reports.levels.size());
+    }
+
+    return reports;
+}
+
+/**
+ * @brief Loads the reports from the binary cache, or parses the text and writes the cache (see input_cache.h).
+ * 
+ * The cache holds the reports CSR-style, like the offsets and levels in Reports. Reading them back through
+ * get_lists checks that the offsets fit the levels, so a malformed cache is rebuilt from the text.
+ */
+Reports load_reports(const std::string& path, bool use_cache) {
+    return load_cached(path, "day2", use_cache, read_reports,
+                       [](const Reports& reports, CacheWriter& writer) {
+                           writer.put_lists(std::views::iota(size_t{0}, reports.size()),
+                                            [&](size_t i) { return reports.report(i); });
+                       },
+                       [](CacheReader& reader) {
+                           Reports reports;
+                           reader.get_lists<int>([&](std::span<const int> levels) {
+                               reports.levels.insert(reports.levels.end(), levels.begin(), levels.end());
+                               reports.offsets.push_back(reports.levels.size());
+                           });
+                           return reports;
+                       });
+}
+
+/**
+ * @brief Counts the reports that are safe with at most a given number of problems.
+ * 
+ * @param reports The reports to check.
+ * @param max_problems The maximum number of problems allowed per report.
+ * @return int The number of safe reports.
+ */
+int count_safe_reports(const Reports& reports, int max_problems = 1) {
     int num_safe_reports = 0;
 
-    while (std::getline(file, line)) {
-        if (is_safe_report(line)) {
+    for (size_t i = 0; i < reports.size(); i++) {
+        if (is_safe_report(reports.report(i), max_problems)) {
             num_safe_reports++;
         }
     }
 
+    return num_safe_reports;
+}
+
+// Count and return the number of safe reports in the data file (pass --bench to time each phase, see benchmark.h).
+// Parsed reports are cached next to the input (see input_cache.h); pass --no-cache to always parse the text.
+int main(int argc, char* argv[]) {
+    const std::string input_path = "../data/day2.txt";
+    bool use_cache = cache_enabled(argc, argv);
+    auto load = [use_cache](const std::string& path) { return load_reports(path, use_cache); };
+
+    // Part one allows no problems, part two allows one (see service.h)
+    int status;
+    if (run_service("day2", input_path, argc, argv, load,
+                    [](Reports& reports, int part) {
+                        return std::to_string(count_safe_reports(reports, (part == 1) ? 0 : 1));
+                    }, status)) {
+        return status;
+    }
+
+    Benchmark bench("day2", argc, argv);
+
+    Reports reports = bench.phase("parse", [&] { return load(input_path); });
+    int num_safe_reports = bench.phase("safe_reports", [&] { return count_safe_reports(reports); });
+
     std::cout << "Number of safe reports: " << num_safe_reports << std::endl;
 
-    return 0;
+    return bench.finish();
 }
\ No newline at end of file
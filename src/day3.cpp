@@ -1,7 +1,60 @@
 #include <fstream>
 #include <iostream>
 #include <string>
-#include <regex>
+#include <string_view>
+
+#include "benchmark.h"
+#include "service.h"
+
+/**
+ * @brief Reads 1 to 3 digits from a position in a string.
+ * 
+ * @param content The string to read from.
+ * @param pos The position to start at, advanced past the digits.
+ * @param number Set to the number that was read.
+ * @return true If at least one digit was read.
+ */
+constexpr bool read_number(std::string_view content, size_t& pos, int& number) {
+    size_t start = pos;
+    number = 0;
+
+    while (pos < content.size() && pos - start < 3 && content[pos] >= '0' && content[pos] <= '9') {
+        number = number * 10 + (content[pos] - '0');
+        pos++;
+    }
+
+    return pos > start;
+}
+
+/**
+ * @brief Matches a `mul(x,y)` pattern (with 1 to 3 digit numbers) at a position in a string.
+ * 
+ * @param content The string to match in.
+ * @param pos The position to match at, advanced past the pattern if it matches.
+ * @param product Set to x * y if the pattern matches.
+ * @return true If the pattern matches.
+ */
+constexpr bool match_mul(std::string_view content, size_t& pos, int& product) {
+    size_t end = pos;
+    int x;
+    int y;
+
+    if (!content.substr(end).starts_with("mul(")) {
+        return false;
+    }
+    end += 4;
+
+    if (!read_number(content, end, x) || end >= content.size() || content[end++] != ',') {
+        return false;
+    }
+    if (!read_number(content, end, y) || end >= content.size() || content[end++] != ')') {
+        return false;
+    }
+
+    product = x * y;
+    pos = end;
+    return true;
+}
 
 /**
  * @brief Counts and multiplies numbers found in specific patterns within a given string.
@@ -9,57 +62,76 @@
  * This function searches for patterns of the form `mul(x,y)`, `do()`, and `don't()` in the input string.
  * It multiplies the numbers found in `mul(x,y)` patterns and sums the products. The `do()` and `don't()`
  * patterns enable or disable the multiplication based on the `check_enable` flag.
+ * The patterns are matched by a single scan over the string, so the function can run at compile time.
  *
  * @param content The input string containing the patterns to be processed.
  * @param check_enable A boolean flag indicating whether to respect the `do()` and `don't()` patterns.
  * @param start_enabled A boolean flag indicating the initial state of the enable flag.
  * @return The sum of the products of the numbers found in the `mul(x,y)` patterns.
  */
-int count_multiply(std::string content, bool check_enable = true, bool start_enabled = true) {
-    std::regex mul_pattern(R"(mul\(\d{1,3},\d{1,3}\)|do\(\)|don't\(\))");  // match mul(1,2), do(), don't()
-    std::regex num_pattern(R"(\d{1,3})");  // match numbers only
-
-    std::sregex_iterator reg_it(content.begin(), content.end(), mul_pattern);
-    std::sregex_iterator end;
-
-    std::string curr_mult;
+constexpr int count_multiply(std::string_view content, bool check_enable = true, bool start_enabled = true) {
     int curr_product;
     int sum_product = 0;
     bool enabled = start_enabled;
+    size_t pos = 0;
 
-    while (reg_it != end) {
-        std::smatch match = *reg_it;
-        curr_mult = match.str();
+    while (pos < content.size()) {
+        std::string_view rest = content.substr(pos);
 
-        if (curr_mult == "do()" || curr_mult == "don't()") {
-            enabled = curr_mult == "do()";
-        } else if ((check_enable && enabled) || !check_enable) {
-            std::sregex_iterator mult_it(curr_mult.begin(), curr_mult.end(), num_pattern);
-            curr_product = 1;
-
-            while (mult_it != end) {
-                std::smatch num_match = *mult_it;
-                curr_product *= std::stoi(num_match.str());
-                ++mult_it;
+        if (rest.starts_with("do()")) {
+            enabled = true;
+            pos += 4;
+        } else if (rest.starts_with("don't()")) {
+            enabled = false;
+            pos += 7;
+        } else if (match_mul(content, pos, curr_product)) {
+            if ((check_enable && enabled) || !check_enable) {
+                sum_product += curr_product;
             }
-
-            sum_product += curr_product;
+        } else {
+            pos++;
         }
-
-        ++reg_it;
     }
 
     return sum_product;
 }
 
-int main() {
-    std::ifstream file("../data/day3.txt");
+// Golden checks on the puzzle's example programs, solved at compile time
+static_assert(count_multiply("xmul(2,4)%&mul[3,7]!@^do_not_mul(5,5)+mul(32,64]then(mul(11,8)mul(8,5))", false) == 161);
+static_assert(count_multiply("xmul(2,4)&mul[3,7]!^don't()_mul(5,5)+mul(32,64](mul(11,8)undo()?mul(8,5))", true) == 48);
+static_assert(count_multiply("mul(1234,5)mul(12,34)", false) == 408);
+
+/**
+ * @brief Reads a whole file into a string.
+ * 
+ * @param path The path to the input file.
+ * @return std::string The contents of the file.
+ */
+std::string read_program(const std::string& path) {
+    std::ifstream file(path);
     std::string content( (std::istreambuf_iterator<char>(file) ),
                          (std::istreambuf_iterator<char>()     ) );
+    return content;
+}
+
+int main(int argc, char* argv[]) {
+    const std::string input_path = "../data/day3.txt";
+
+    // Part one ignores the do()/don't() instructions, part two respects them (see service.h)
+    int status;
+    if (run_service("day3", input_path, argc, argv, read_program,
+                    [](std::string& content, int part) { return std::to_string(count_multiply(content, part == 2)); },
+                    status)) {
+        return status;
+    }
+
+    Benchmark bench("day3", argc, argv);
+
+    std::string content = bench.phase("read", [&] { return read_program(input_path); });
 
-    int total = count_multiply(content, true);
+    int total = bench.phase("multiply", [&] { return count_multiply(content, true); });
 
     std::cout << "Total multiplication: " << total << std::endl;
 
-    return 0;
+    return bench.finish();
 }
@@ -3,6 +3,13 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <array>
+#include <span>
+#include <string_view>
+
+#include "benchmark.h"
+#include "input_cache.h"
+#include "service.h"
 
 
 /**
@@ -10,19 +17,20 @@
  * 
  * This function searches for the specified word in the provided word search grid.
  * It checks all possible directions (horizontally, vertically, and diagonally) 
- * to find the word and counts its occurrences.
+ * to find the word and counts its occurrences. The grid is only viewed (never copied), so the function can
+ * run at compile time.
  * 
- * @param word_search A vector of strings representing the word search grid.
+ * @param word_search The rows of the word search grid.
  * @param word_to_find The word to search for in the grid.
  * @return int The number of times the word is found in the grid.
  */
-int count_word_search(std::vector<std::string> word_search, std::string word_to_find) {
+constexpr int count_word_search(std::span<const std::string_view> word_search, std::string_view word_to_find) {
     int row = 0;
     int col = 0;
     int cnt = 0;
 
     // Main search loop
-    for (const std::string& line : word_search) {
+    for (std::string_view line : word_search) {
         col = 0;
         for (char c : line) {
             if (c == word_to_find[0]) {
@@ -30,7 +38,7 @@ int count_word_search(std::vector<std::string> word_search, std::string word_to_
                 for (int i = std::max(row-1, 0); i <= std::min(row+1, int(word_search.size()) - 1); i++) {
                     for (int j = std::max(col-1, 0); j <= std::min(col+1, int(line.length()) - 1); j++) {
                         if (!(i == row && j == col)) {
-                            if (word_search[i].at(j) == word_to_find[1]) {
+                            if (word_search[i][j] == word_to_find[1]) {
                                 int h_direction = j - col;  // 1=right, -1=left
                                 int v_direction = i - row;  // 1=down, -1=up
 
@@ -46,7 +54,7 @@ int count_word_search(std::vector<std::string> word_search, std::string word_to_
                                             found_word = false;
                                             break;
                                     }
-                                    if (word_search[curr_row].at(curr_col) != word_to_find[k + 2]) {
+                                    if (word_search[curr_row][curr_col] != word_to_find[k + 2]) {
                                         found_word = false;
                                         break;
                                     }
@@ -77,26 +85,26 @@ int count_word_search(std::vector<std::string> word_search, std::string word_to_
  * - The letter 'A' must be surrounded diagonally by 'M' and 'S' in any order.
  * - For example, 'A' should have 'M' and 'S' diagonally adjacent in any of the four corners.
  * 
- * @param word_search A vector of strings representing the word search grid.
+ * @param word_search The rows of the word search grid.
  * @return int The number of times the pattern "XMAS" is found in the grid.
  */
-int count_xmas(std::vector<std::string> word_search) {
+constexpr int count_xmas(std::span<const std::string_view> word_search) {
     int row = 0;
     int col = 0;
     int cnt = 0;
 
     // Main search loop
-    for (const std::string& line : word_search) {
+    for (std::string_view line : word_search) {
         col = 0;
         for (char c : line) {
             if (c == 'A') {
                 // Check diagonal characters for M and S
                 if (row > 0 && (row < word_search.size() - 1) && col > 0 && (col < line.length() - 1)) {
                     bool found_xmas = true;
-                    char top_left = word_search[row-1].at(col-1);
-                    char top_right = word_search[row-1].at(col+1);
-                    char bottom_left = word_search[row+1].at(col-1);
-                    char bottom_right = word_search[row+1].at(col+1);
+                    char top_left = word_search[row-1][col-1];
+                    char top_right = word_search[row-1][col+1];
+                    char bottom_left = word_search[row+1][col-1];
+                    char bottom_right = word_search[row+1][col+1];
                     if (top_left == 'M') {
                         if (bottom_right != 'S') {
                             found_xmas = false;
@@ -134,8 +142,214 @@ int count_xmas(std::vector<std::string> word_search) {
     return cnt;
 }
 
-int main() {
-    std::ifstream file("../data/day4.txt");
+// Golden checks on the puzzle's example grid, solved at compile time
+constexpr std::array<std::string_view, 10> example_grid = {
+    "MMMSXXMASM", "MSAMXMSMSA", "AMXSXMAAMM", "MSAMASMSMX", "XMASAMXAMM",
+    "XXAMMXXAMA", "SMSMSASXSS", "SAXAMASAAA", "MAMMMXMMMM", "MXMXAXMASX",
+};
+static_assert(count_word_search(example_grid, "XMAS") == 18);
+static_assert(count_xmas(example_grid) == 9);
+
+/**
+ * @brief The most recent rows of a word search grid, kept in a ring buffer while the grid is streamed.
+ * 
+ * Only as many rows as the longest pattern spans are held, so memory doesn't grow with the grid height. Row
+ * buffers are reused once the window is full, so steady-state pushes don't allocate.
+ */
+class RowWindow {
+public:
+    /**
+     * @brief Constructs a RowWindow object.
+     * 
+     * @param capacity The number of rows to keep.
+     */
+    constexpr RowWindow(size_t capacity) : rows_(capacity), count_(0) {}
+
+    /**
+     * @brief Adds a row below the others, dropping the oldest row if the window is full.
+     */
+    constexpr void push(std::string_view row) {
+        rows_[count_ % rows_.size()].assign(row);
+        count_++;
+    }
+
+    /**
+     * @brief Returns a row by age: 0 is the newest row, 1 the one above it, and so on.
+     */
+    constexpr std::string_view row(size_t age) const {
+        return rows_[(count_ - 1 - age) % rows_.size()];
+    }
+
+    /**
+     * @brief Returns the number of rows currently held (at most the capacity).
+     */
+    constexpr size_t size() const {
+        return std::min(count_, rows_.size());
+    }
+
+private:
+    std::vector<std::string> rows_;
+    size_t count_;
+};
+
+/**
+ * @brief Checks whether a word is spelled from a cell of the window, stepping by a fixed row age and column offset.
+ * 
+ * @param window The rows held in the window.
+ * @param word The word to match.
+ * @param age The age of the row holding the first letter (see RowWindow::row).
+ * @param age_step The change in age per letter (1 reads upwards, -1 downwards, 0 along the row).
+ * @param col The column of the first letter.
+ * @param col_step The change in column per letter.
+ */
+constexpr bool matches_word(const RowWindow& window, std::string_view word, int age, int age_step, int col, int col_step) {
+    for (char letter : word) {
+        if (age < 0 || age >= int(window.size()) || col < 0 || col >= int(window.row(age).size()) ||
+            window.row(age)[col] != letter) {
+            return false;
+        }
+        age += age_step;
+        col += col_step;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Counts the occurrences of a word whose lowest letter lies in the newest row of the window.
+ * 
+ * Summed over every row as the grid is streamed, this counts each occurrence exactly once, in all eight
+ * directions, matching count_word_search. The window must hold at least as many rows as the word has letters.
+ * 
+ * @param window The most recent rows of the grid.
+ * @param word_to_find The word to search for.
+ * @return int The number of occurrences that end in the newest row.
+ */
+constexpr int count_word_search_newest(const RowWindow& window, std::string_view word_to_find) {
+    int last = int(word_to_find.length()) - 1;
+    int cnt = 0;
+
+    for (int col = 0; col < int(window.row(0).size()); col++) {
+        // Along the newest row
+        cnt += matches_word(window, word_to_find, 0, 0, col, 1);
+        cnt += matches_word(window, word_to_find, 0, 0, col, -1);
+
+        for (int col_step = -1; col_step <= 1; col_step++) {
+            // Reading upwards from the newest row, or downwards into it
+            cnt += matches_word(window, word_to_find, 0, 1, col, col_step);
+            cnt += matches_word(window, word_to_find, last, -1, col - col_step * last, col_step);
+        }
+    }
+
+    return cnt;
+}
+
+/**
+ * @brief Counts the X-MAS patterns whose bottom row is the newest row of the window (see count_xmas).
+ * 
+ * @param window The most recent rows of the grid (at least three).
+ * @return int The number of X-MAS patterns centered in the row above the newest one.
+ */
+constexpr int count_xmas_newest(const RowWindow& window) {
+    if (window.size() < 3) {
+        return 0;
+    }
+
+    std::string_view top = window.row(2);
+    std::string_view middle = window.row(1);
+    std::string_view bottom = window.row(0);
+    size_t width = std::min({top.size(), middle.size(), bottom.size()});
+    int cnt = 0;
+
+    for (size_t col = 1; col + 1 < width; col++) {
+        if (middle[col] != 'A') {
+            continue;
+        }
+
+        // Each diagonal must read MAS in one direction or the other
+        bool down_right = (top[col-1] == 'M' && bottom[col+1] == 'S') || (top[col-1] == 'S' && bottom[col+1] == 'M');
+        bool down_left = (top[col+1] == 'M' && bottom[col-1] == 'S') || (top[col+1] == 'S' && bottom[col-1] == 'M');
+
+        if (down_right && down_left) {
+            cnt++;
+        }
+    }
+
+    return cnt;
+}
+
+/**
+ * @brief Streams rows through a RowWindow, counting both puzzle patterns as each row arrives.
+ * 
+ * @tparam Rows A range of rows (e.g. strings or string_views).
+ * @param rows The rows of the grid, top to bottom.
+ * @param word_to_find The word to search for.
+ * @return std::pair<int, int> The word count and the X-MAS count.
+ */
+template <typename Rows>
+constexpr std::pair<int, int> stream_word_search(Rows&& rows, std::string_view word_to_find) {
+    RowWindow window(std::max<size_t>(word_to_find.length(), 3));
+    std::pair<int, int> cnt = {0, 0};
+
+    for (std::string_view row : rows) {
+        window.push(row);
+        cnt.first += count_word_search_newest(window, word_to_find);
+        cnt.second += count_xmas_newest(window);
+    }
+
+    return cnt;
+}
+
+/**
+ * @brief The lines of a stream, read one at a time into a reused buffer, as a range for stream_word_search.
+ */
+class LineRange {
+public:
+    LineRange(std::istream& file) : file_(file) {}
+
+    struct Iterator {
+        LineRange* range;
+
+        std::string_view operator*() const {
+            return range->line_;
+        }
+        Iterator& operator++() {
+            range->advance();
+            return *this;
+        }
+        bool operator!=(const Iterator&) const {
+            return !range->done_;
+        }
+    };
+
+    Iterator begin() {
+        advance();
+        return {this};
+    }
+    Iterator end() {
+        return {this};
+    }
+
+private:
+    void advance() {
+        done_ = !std::getline(file_, line_);
+    }
+
+    std::istream& file_;
+    std::string line_;
+    bool done_ = false;
+};
+
+static_assert(stream_word_search(example_grid, "XMAS") == std::pair(18, 9));
+
+/**
+ * @brief Reads the word search grid from a file, one row per line.
+ * 
+ * @param path The path to the input file.
+ * @return std::vector<std::string> The rows of the grid.
+ */
+std::vector<std::string> read_word_search(const std::string& path) {
+    std::ifstream file(path);
     std::string line;
     std::vector<std::string> lines;
 
@@ -143,13 +357,76 @@ int main() {
         lines.push_back(line);
     }
 
+    return lines;
+}
+
+/**
+ * @brief Loads the word search grid from the binary cache, or parses the text and writes the cache (see input_cache.h).
+ * 
+ * The cache holds the rows packed back to back, with their offsets.
+ */
+std::vector<std::string> load_word_search(const std::string& path, bool use_cache) {
+    return load_cached(path, "day4", use_cache, read_word_search,
+                       [](const std::vector<std::string>& lines, CacheWriter& writer) { writer.put_lists(lines); },
+                       [](CacheReader& reader) {
+                           std::vector<std::string> lines;
+                           reader.get_lists<char>([&](std::span<const char> row) { lines.emplace_back(row.begin(), row.end()); });
+                           return lines;
+                       });
+}
+
+/**
+ * @brief Counts both puzzle patterns in the word search and prints the results.
+ * 
+ * Pass --stream to count while reading the grid row by row, holding only a few rows in memory, or --bench to
+ * time each phase (see benchmark.h). With --serve / --query, the grid stays loaded in a resident service (see
+ * service.h). Otherwise the parsed grid is cached next to the input (see input_cache.h); pass --no-cache to always
+ * parse the text.
+ */
+int main(int argc, char* argv[]) {
+    const std::string input_path = "../data/day4.txt";
     std::string word_to_find = "XMAS";
+    bool stream = false;
+    bool use_cache = cache_enabled(argc, argv);
+    auto load = [use_cache](const std::string& path) { return load_word_search(path, use_cache); };
+
+    for (int i = 1; i < argc; i++) {
+        stream = stream || std::string(argv[i]) == "--stream";
+    }
+
+    int status;
+    if (run_service("day4", input_path, argc, argv, load,
+                    [](std::vector<std::string>& lines, int part) {
+                        std::vector<std::string_view> rows(lines.begin(), lines.end());
+                        return std::to_string((part == 1) ? count_word_search(rows, "XMAS") : count_xmas(rows));
+                    }, status)) {
+        return status;
+    }
+
+    Benchmark bench("day4", argc, argv);
+
+    // Grids larger than memory are never loaded whole
+    if (stream) {
+        auto [total_cnt, xmas_cnt] = bench.phase("stream", [&] {
+            std::ifstream file(input_path);
+            return stream_word_search(LineRange(file), word_to_find);
+        });
+
+        std::cout << "Total count for " << word_to_find << " is: " << total_cnt << std::endl;
+        std::cout << "Total X-MAS count for part two is: " << xmas_cnt << std::endl;
+
+        return bench.finish();
+    }
+
+    std::vector<std::string> lines = bench.phase("parse", [&] { return load(input_path); });
+
+    std::vector<std::string_view> rows(lines.begin(), lines.end());
 
-    int total_cnt = count_word_search(lines, word_to_find);
-    int xmas_cnt = count_xmas(lines);
+    int total_cnt = bench.phase("word_search", [&] { return count_word_search(rows, word_to_find); });
+    int xmas_cnt = bench.phase("xmas", [&] { return count_xmas(rows); });
 
     std::cout << "Total count for " << word_to_find << " is: " << total_cnt << std::endl;
     std::cout << "Total X-MAS count for part two is: " << xmas_cnt << std::endl;
 
-    return 0;
+    return bench.finish();
 }
@@ -6,6 +6,13 @@
 #include <set>
 #include <sstream>
 #include <algorithm>
+#include <span>
+#include <memory_resource>
+
+#include "arena.h"
+#include "benchmark.h"
+#include "input_cache.h"
+#include "service.h"
 
 using NumberLists = std::vector<std::vector<int>>;
 using NumberMap = std::unordered_map<int, std::set<int>>;
@@ -26,24 +33,28 @@ struct Updates {
 /**
  * @brief Sorts each list of numbers in the updates and returns the sorted lists.
  * 
+ * The sets and lists used while sorting an update come from a ScratchArena that is reset after each update.
+ * 
  * @param updates The lists of numbers to be sorted.
  * @param after_map A map that defines the order constraints for sorting.
  * @return NumberLists The sorted lists of numbers.
  */
-NumberLists sort_updates(NumberLists updates, NumberMap after_map) {
+NumberLists sort_updates(const NumberLists& updates, const NumberMap& after_map) {
     NumberLists sorted_updates;
+    ScratchArena arena;
 
-    for (auto update : updates) {
+    for (const auto& update : updates) {
+        arena.reset();
 
-        std::set<int> to_sort(update.begin(), update.end());\
-        std::vector<int> sorted_list;
+        std::pmr::set<int> to_sort(update.begin(), update.end(), arena.resource());
+        std::pmr::vector<int> sorted_list(arena.resource());
 
         while (to_sort.size() > 0) {
             for (int page : update) {
                 if (to_sort.contains(page)) {
                     if (after_map.contains(page)) {
-                        std::set<int> intersection;
-                        std::set<int> set1 = after_map.at(page);
+                        std::pmr::set<int> intersection(arena.resource());
+                        const std::set<int>& set1 = after_map.at(page);
 
                         // Only insert the page in sorted list if does not have to be after any unsorted pages
                         std::set_intersection(set1.begin(), set1.end(),
@@ -51,7 +62,7 @@ NumberLists sort_updates(NumberLists updates, NumberMap after_map) {
                                             std::inserter(intersection, intersection.begin()));
                         
                         if (intersection.size() == 0) {
-                            sorted_list.push_back(page);\
+                            sorted_list.push_back(page);
                             to_sort.erase(page);
                         }
 
@@ -65,7 +76,7 @@ NumberLists sort_updates(NumberLists updates, NumberMap after_map) {
 
         }
 
-        sorted_updates.push_back(sorted_list);
+        sorted_updates.emplace_back(sorted_list.begin(), sorted_list.end());
     }
 
     return sorted_updates;
@@ -74,21 +85,24 @@ NumberLists sort_updates(NumberLists updates, NumberMap after_map) {
 /**
  * @brief Splits the updates into ordered and unordered lists based on the before and after maps.
  * 
+ * The sets used while checking an update come from a ScratchArena that is reset after each update.
+ * 
  * @param updates The lists of numbers to be split.
  * @param before_map A map that defines the order constraints before each number.
  * @param after_map A map that defines the order constraints after each number.
  * @return An Updates object containing the ordered and unordered lists.
  */
-Updates split_updates(NumberLists updates, NumberMap before_map, NumberMap after_map) { 
+Updates split_updates(const NumberLists& updates, const NumberMap& before_map, const NumberMap& after_map) { 
     NumberLists ordered_updates;
     NumberLists unordered_updates;
+    ScratchArena arena;
 
-    // Temporary sets of pages before/after current page
-    std::set<int> before_page;
+    for (const auto& update : updates) {
+        arena.reset();
 
-    for (auto update : updates) {
-        before_page.clear();
-        std::set<int> after_page(update.begin(), update.end());
+        // Temporary sets of pages before/after current page
+        std::pmr::set<int> before_page(arena.resource());
+        std::pmr::set<int> after_page(update.begin(), update.end(), arena.resource());
         bool is_ordered = true;
 
         for (int page : update) {
@@ -96,8 +110,8 @@ Updates split_updates(NumberLists updates, NumberMap before_map, NumberMap after
 
             // Intersect after_map with after_page -> should be empty
             if (after_map.contains(page)) {
-                std::set<int> intersection;
-                std::set<int> set1 = after_map.at(page);
+                std::pmr::set<int> intersection(arena.resource());
+                const std::set<int>& set1 = after_map.at(page);
 
                 std::set_intersection(set1.begin(), set1.end(),
                                       after_page.begin(), after_page.end(),
@@ -111,8 +125,8 @@ Updates split_updates(NumberLists updates, NumberMap before_map, NumberMap after
 
             // Intersect before_map with before_page -> should be empty
             if (before_map.contains(page)) {
-                std::set<int> intersection;
-                std::set<int> set1 = before_map.at(page);
+                std::pmr::set<int> intersection(arena.resource());
+                const std::set<int>& set1 = before_map.at(page);
 
                 std::set_intersection(set1.begin(), set1.end(),
                                       before_page.begin(), before_page.end(),
@@ -144,10 +158,10 @@ Updates split_updates(NumberLists updates, NumberMap before_map, NumberMap after
  * @param updates The lists of numbers to be processed.
  * @return int The sum of the middle numbers of each list.
  */
-int sum_middle_numbers(NumberLists updates) {
+int sum_middle_numbers(const NumberLists& updates) {
     int cnt = 0;
 
-    for (auto update : updates) {
+    for (const auto& update : updates) {
         int middle_idx = update.size() / 2;
         cnt += update[middle_idx];
     }
@@ -156,22 +170,36 @@ int sum_middle_numbers(NumberLists updates) {
 }
 
 /**
- * Detect unsorted lists of integers (i.e. updates) and sort them according to a set of rules.
+ * @brief The parsed puzzle input: ordering rules in both directions, and the updates to check.
  */
-int main() {
-    std::ifstream file("../data/day5.txt");
-    std::string line;
+struct PrintQueue {
     NumberMap before_map;
     NumberMap after_map;
     NumberLists updates;
+};
+
+/**
+ * @brief Reads the ordering rules and updates from a file.
+ * 
+ * @param path The path to the input file.
+ * @return PrintQueue The parsed rules and updates.
+ */
+PrintQueue read_print_queue(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::string temp;
+    std::istringstream iss;  // Reused for every line, like temp
+    ScratchArena arena;
+    PrintQueue queue;
 
     while (std::getline(file, line)) {
         if (line.empty()) {
             continue;
         }
 
-        std::string temp;
-        std::istringstream iss(line);
+        iss.clear();
+        iss.str(line);
+        arena.reset();
 
         // Add rules
         if (line.find('|') != std::string::npos) {
@@ -181,29 +209,102 @@ int main() {
             std::getline(iss, temp, '|');
             int second_num = std::stoi(temp);
 
-            before_map[first_num].insert(second_num);
-            after_map[second_num].insert(first_num);
+            queue.before_map[first_num].insert(second_num);
+            queue.after_map[second_num].insert(first_num);
         } 
         
         // Add updates
         else {
-            std::vector<int> pages;
+            std::pmr::vector<int> pages(arena.resource());
 
             while (std::getline(iss, temp, ',')) {
                 pages.push_back(std::stoi(temp));
             }
 
-            updates.push_back(pages);
+            queue.updates.emplace_back(pages.begin(), pages.end());
         }
     }
 
-    Updates result = split_updates(updates, before_map, after_map);  // Split into ordered and unordered updates
+    return queue;
+}
+
+/**
+ * @brief Loads the rules and updates from the binary cache, or parses the text and writes the cache (see input_cache.h).
+ * 
+ * The cache holds the rules as flat (before, after) pairs and the updates CSR-style; the rule maps are rebuilt from
+ * the pairs.
+ * 
+ * @param path The path to the input file.
+ * @param use_cache False to always parse the text.
+ * @return PrintQueue The parsed rules and updates.
+ */
+PrintQueue load_print_queue(const std::string& path, bool use_cache) {
+    return load_cached(path, "day5", use_cache, read_print_queue,
+                       [](const PrintQueue& queue, CacheWriter& writer) {
+                           std::vector<int> rules;
+                           for (const auto& [first_num, second_nums] : queue.before_map) {
+                               for (int second_num : second_nums) {
+                                   rules.push_back(first_num);
+                                   rules.push_back(second_num);
+                               }
+                           }
+
+                           writer.put_array(rules);
+                           writer.put_lists(queue.updates);
+                       },
+                       [](CacheReader& reader) {
+                           PrintQueue queue;
+                           std::span<const int> rules = reader.get_array<int>();
+
+                           // Rules are (before, after) pairs, or the cache is rebuilt from the text
+                           if (rules.size() % 2 != 0) {
+                               reader.fail();
+                           }
+
+                           for (size_t i = 0; i + 1 < rules.size(); i += 2) {
+                               queue.before_map[rules[i]].insert(rules[i + 1]);
+                               queue.after_map[rules[i + 1]].insert(rules[i]);
+                           }
+
+                           reader.get_lists<int>([&](std::span<const int> pages) { queue.updates.emplace_back(pages.begin(), pages.end()); });
+                           return queue;
+                       });
+}
+
+/**
+ * Detect unsorted lists of integers (i.e. updates) and sort them according to a set of rules.
+ * Pass --bench to time each phase (see benchmark.h), or --serve / --query to keep the rules and updates loaded in a
+ * resident service (see service.h). The parsed input is cached next to the text (see input_cache.h); pass --no-cache
+ * to always parse the text.
+ */
+int main(int argc, char* argv[]) {
+    const std::string input_path = "../data/day5.txt";
+    bool use_cache = cache_enabled(argc, argv);
+    auto load = [use_cache](const std::string& path) { return load_print_queue(path, use_cache); };
+
+    int status;
+    if (run_service("day5", input_path, argc, argv, load,
+                    [](PrintQueue& queue, int part) {
+                        Updates result = split_updates(queue.updates, queue.before_map, queue.after_map);
+                        int middle_sum = (part == 1) ? sum_middle_numbers(result.ordered)
+                                                     : sum_middle_numbers(sort_updates(result.unordered, queue.after_map));
+                        return std::to_string(middle_sum);
+                    }, status)) {
+        return status;
+    }
+
+    Benchmark bench("day5", argc, argv);
+
+    PrintQueue queue = bench.phase("parse", [&] { return load(input_path); });
+
+    // Split into ordered and unordered updates
+    Updates result = bench.phase("split_updates", [&] { return split_updates(queue.updates, queue.before_map, queue.after_map); });
     int middle_sum = sum_middle_numbers(result.ordered);
     std::cout << "Total sum of middle numbers: " << middle_sum << std::endl;
 
-    NumberLists sorted = sort_updates(result.unordered, after_map);
+    NumberLists sorted = bench.phase("sort_updates", [&] { return sort_updates(result.unordered, queue.after_map); });
     int middle_sorted_sum = sum_middle_numbers(sorted);
     std::cout << "Total sorted sum of middle numbers: " << middle_sorted_sum << std::endl;
 
-    return 0;
+    return bench.finish();
 }
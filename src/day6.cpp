@@ -8,10 +8,22 @@
  * The main functions in this file are:
  * - count_token: Counts the occurrences of a specific token in the grid.
  * - get_token_location: Finds the location of a specific token in the grid.
+ * - VisitedStates: Epoch-stamped (cell, direction) set used to detect loops without clearing between walks.
+ * - walk_guard: Walks the guard from a given state, optionally marking positions, and detects loops.
  * - get_guard_path: Simulates the guard's path through the grid, marking positions and detecting loops.
- * - part_one: Solves the first part of the challenge by counting the number of guard positions.
- * - part_two: Solves the second part of the challenge by counting obstacles that create loops.
- * - main: Reads the input grid from a file and calls the functions to solve both parts of the challenge.
+ * - get_obstacle_trials: Finds the candidate obstacle cells on the guard path and where to resume each trial.
+ * - JumpTable: Precomputed next stop for every cell and heading, with one extra obstacle overlaid per query.
+ * - is_loop_trial: Jumps the guard from turn to turn with one extra obstacle and detects loops.
+ * - count_guard_positions / part_one: Solve the first part of the challenge by counting the number of guard positions.
+ * - count_loop_obstacles / part_two: Solve the second part of the challenge by counting obstacles that create loops,
+ *   trying candidate obstacles in parallel across worker threads.
+ * - SparseMap: Obstacles as sorted per-row and per-column lists, for huge maps that don't fit in a Grid.
+ * - get_guard_segments: Walks the guard across a sparse map from turn to turn.
+ * - part_one_sparse / part_two_sparse: Solve both parts on a sparse map, tracking visited cells as merged intervals.
+ * - main: Reads the input grid from a file and calls the functions to solve both parts of the challenge
+ *   (pass --sparse to stream the file into a SparseMap instead, or --bench to time each phase, see benchmark.h).
+ *   With --serve / --query, the grid stays loaded in a resident service that answers both parts (see service.h).
+ *   The parsed grid is cached next to the input (see input_cache.h); pass --no-cache to always parse the text.
  * 
  * @param grid The grid representing the area the guard navigates.
  * @param token The character token to search for in the grid.
@@ -23,12 +35,36 @@
 #include <string>
 #include <vector>
 #include <utility>
-#include <unordered_map>
+#include <cstdint>
 #include <array>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdlib>
+#include <map>
+#include <unordered_set>
+#include <limits>
+#include <iterator>
+#include <span>
+
+#include "benchmark.h"
+#include "input_cache.h"
+#include "service.h"
 
 using Grid = std::vector<std::string>;
 using Coordinate = std::pair<int, int>;
-using BarrierHitCount = std::unordered_map<std::string, std::array<size_t, 4>>;
+
+const std::array<Coordinate, 4> directions = {{{-1, 0}, {0, 1}, {1, 0}, {0, -1}}};  // up, right, down, left
+
+struct GuardState {
+    Coordinate pos;
+    int dir;  // Index into directions
+};
+
+struct ObstacleTrial {
+    Coordinate obstacle;
+    GuardState start;  // Guard state just before first reaching the obstacle cell
+};
 
 int count_token(Grid grid, char token) {
     int cnt = 0;
@@ -76,124 +112,748 @@ Coordinate get_token_location(Grid grid, char token) {
     return token_pos;
 }
 
-Grid get_guard_path(Grid grid) {
-    int guard_horizontal = 0;
-    int guard_vertical = -1;  // Always starts walking vertically up
-    Grid guard_path;
-    BarrierHitCount barrier_cnt;  // Track number of times hitting a barrier from each direction [0->top, 1->right, 2->bottom, 3->left]
-    bool stuck_in_loop = false;
+/**
+ * @brief Tracks which (cell, direction) states the guard has turned in, for loop detection.
+ *
+ * Each state holds the epoch it was last visited in, so starting a new walk only bumps the
+ * current epoch instead of clearing the whole array.
+ */
+class VisitedStates {
+public:
+    /**
+     * @brief Constructs a VisitedStates object.
+     *
+     * @param keys The number of places a turn can happen at (grid cells, or obstacles on a sparse map).
+     */
+    VisitedStates(size_t keys)
+        : stamps_(keys * 4, 0), epoch_(0) {}
+
+    /**
+     * @brief Forgets all visited states in O(1).
+     */
+    void reset() {
+        epoch_++;
+
+        // Stamps from 2^32 walks ago would look current again, so clear them for real on wraparound
+        if (epoch_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            epoch_ = 1;
+        }
+    }
 
-    std::copy(grid.begin(), grid.end(), std::back_inserter(guard_path));
+    /**
+     * @brief Marks a state as visited.
+     *
+     * @param key Where the turn happens (index of the grid cell or obstacle).
+     * @param dir The guard heading (index into directions).
+     * @return true If the state was already visited since the last reset.
+     * @return false Otherwise.
+     */
+    bool visit(size_t key, int dir) {
+        uint32_t& stamp = stamps_[key * 4 + dir];
+        bool seen = (stamp == epoch_);
+        stamp = epoch_;
+        return seen;
+    }
+
+private:
+    std::vector<uint32_t> stamps_;
+    uint32_t epoch_;
+};
+
+/**
+ * @brief Walks the guard from a given state until they exit the grid or get stuck in a loop.
+ *
+ * The guard is stuck in a loop once they turn from the same cell and heading twice. Only turns
+ * are recorded, since every loop has to contain at least one.
+ *
+ * @param grid The grid representing the area the guard navigates.
+ * @param state The position and heading the guard starts from.
+ * @param visited Scratch visited states, reset before walking.
+ * @param guard_path Optional grid to mark every visited position with 'X'.
+ * @return true If the guard gets stuck in a loop.
+ * @return false If the guard walks off the grid.
+ */
+bool walk_guard(const Grid& grid, GuardState state, VisitedStates& visited, Grid* guard_path = nullptr) {
+    int rows = static_cast<int>(grid.size());
+    int cols = static_cast<int>(grid[0].size());
+
+    visited.reset();
 
-    Coordinate guard_pos = get_token_location(grid, '^');
-    guard_path[guard_pos.first].at(guard_pos.second) = 'X';
+    if (guard_path) {
+        (*guard_path)[state.pos.first].at(state.pos.second) = 'X';
+    }
 
     // Walk the guard until they exit the grid (or get stuck in a loop)
     while (true) {
-        Coordinate next_pos = {guard_pos.first + guard_vertical, guard_pos.second + guard_horizontal};
+        Coordinate next_pos = {state.pos.first + directions[state.dir].first, state.pos.second + directions[state.dir].second};
 
         // About to walk off the grid
-        if (next_pos.first < 0 || next_pos.first >= grid.size() || next_pos.second < 0 || next_pos.second >= grid[0].size()) {
-            break;
+        if (next_pos.first < 0 || next_pos.first >= rows || next_pos.second < 0 || next_pos.second >= cols) {
+            return false;
         }
         
         // About to hit a barrier (turn right)
-        else if (grid[next_pos.first].at(next_pos.second) == '#') {
-            std::string barrier_key = std::to_string(next_pos.first) + std::to_string(next_pos.second);
-            if (!barrier_cnt.contains(barrier_key)) {
-                std::fill(barrier_cnt[barrier_key].begin(), barrier_cnt[barrier_key].end(), 0);
+        if (grid[next_pos.first][next_pos.second] == '#') {
+            if (visited.visit(state.pos.first * cols + state.pos.second, state.dir)) {
+                return true;
             }
 
-            if (guard_horizontal == 0) {
-                if (guard_vertical > 0) {
-                    guard_horizontal = -1;
-                    barrier_cnt[barrier_key][0] += 1;
-                } else {
-                    guard_horizontal = 1;
-                    barrier_cnt[barrier_key][2] += 1;
-                }
-                guard_vertical = 0;
-            } else {
-                if (guard_horizontal > 0) {
-                    guard_vertical = 1;
-                    barrier_cnt[barrier_key][3] += 1;
-                } else {
-                    guard_vertical = -1;
-                    barrier_cnt[barrier_key][1] += 1;
-                }
-                guard_horizontal = 0;
+            state.dir = (state.dir + 1) % 4;
+            continue;
+        }
+
+        // Update guard position and path
+        state.pos = next_pos;
+
+        if (guard_path) {
+            (*guard_path)[state.pos.first][state.pos.second] = 'X';
+        }
+    }
+}
+
+Grid get_guard_path(Grid grid) {
+    Grid guard_path;
+    VisitedStates visited(grid.size() * grid[0].size());
+
+    std::copy(grid.begin(), grid.end(), std::back_inserter(guard_path));
+
+    GuardState start = {get_token_location(grid, '^'), 0};  // Always starts walking vertically up
+
+    if (walk_guard(grid, start, visited, &guard_path)) {
+        guard_path[0].at(0) = 'O';  // Mark this guard path as a loop
+    }
+
+    return guard_path;
+}
+
+/**
+ * @brief Finds every cell on the original guard path where a new obstacle could change the route.
+ *
+ * Obstacles placed off the original path are never reached, so only cells the guard walks through
+ * need to be tried. Each candidate is paired with the guard state just before it first enters that
+ * cell, which is where a trial with the new obstacle can resume from. If the original route is
+ * itself a loop, the walk stops once it comes back to a turn it already made.
+ *
+ * @param grid The grid representing the area the guard navigates.
+ * @return std::vector<ObstacleTrial> The candidate obstacle cells and their resume states.
+ */
+std::vector<ObstacleTrial> get_obstacle_trials(const Grid& grid) {
+    int rows = static_cast<int>(grid.size());
+    int cols = static_cast<int>(grid[0].size());
+    std::vector<ObstacleTrial> trials;
+    std::vector<std::vector<bool>> seen(rows, std::vector<bool>(cols, false));
+    VisitedStates visited(static_cast<size_t>(rows) * cols);
+    GuardState state = {get_token_location(grid, '^'), 0};
+
+    seen[state.pos.first][state.pos.second] = true;  // Can't place an obstacle on the guard
+    visited.reset();
+
+    while (true) {
+        Coordinate next_pos = {state.pos.first + directions[state.dir].first, state.pos.second + directions[state.dir].second};
+
+        if (next_pos.first < 0 || next_pos.first >= rows || next_pos.second < 0 || next_pos.second >= cols) {
+            break;
+        }
+
+        if (grid[next_pos.first].at(next_pos.second) == '#') {
+            if (visited.visit(state.pos.first * cols + state.pos.second, state.dir)) {
+                break;  // The original route loops, so every cell on it has been seen
             }
 
-            // Break if we are stuck in a loop (more than one hit on a single side)
-            for (size_t hit_cnt : barrier_cnt[barrier_key]) {
-                if (hit_cnt > 1) {
-                    guard_path[0].at(0) = 'O';  // Mark this guard path as a loop
-                    stuck_in_loop = true;
-                    break;
+            state.dir = (state.dir + 1) % 4;
+            continue;
+        }
+
+        if (!seen[next_pos.first][next_pos.second]) {
+            seen[next_pos.first][next_pos.second] = true;
+            trials.push_back({next_pos, state});
+        }
+
+        state.pos = next_pos;
+    }
+
+    return trials;
+}
+
+/**
+ * @brief Precomputed next stop for every cell and heading, so a walk jumps from turn to turn.
+ *
+ * A single extra obstacle is overlaid at query time rather than patched into the table, so the
+ * table is built once and shared read-only by every part two trial.
+ */
+class JumpTable {
+public:
+    /**
+     * @brief Constructs a JumpTable object from a grid.
+     *
+     * @param grid The grid representing the area the guard navigates.
+     */
+    JumpTable(const Grid& grid)
+        : rows_(static_cast<int>(grid.size())), cols_(static_cast<int>(grid[0].size())), stops_(rows_ * cols_ * 4, -1) {
+        // Sweep each row and column in both directions, carrying the last free cell before an obstacle
+        for (int dir = 0; dir < 4; dir++) {
+            int lines = (directions[dir].first != 0) ? cols_ : rows_;
+            int length = (directions[dir].first != 0) ? rows_ : cols_;
+
+            for (int line = 0; line < lines; line++) {
+                int stop = -1;
+
+                for (int step = 0; step < length; step++) {
+                    // Walk against the heading so the stop ahead of each cell is already known
+                    int k = (directions[dir].first + directions[dir].second > 0) ? length - 1 - step : step;
+                    int row = (directions[dir].first != 0) ? k : line;
+                    int col = (directions[dir].first != 0) ? line : k;
+
+                    if (grid[row][col] == '#') {
+                        stop = -2;  // The next free cell becomes the stop
+                        continue;
+                    }
+
+                    if (stop == -2) {
+                        stop = row * cols_ + col;
+                    }
+
+                    stops_[(row * cols_ + col) * 4 + dir] = stop;
                 }
             }
+        }
+    }
 
-            if (stuck_in_loop) {
-                break;
-            }
+    /**
+     * @brief Finds where the guard stops when walking from a position until something is in the way.
+     *
+     * @param pos The guard position.
+     * @param dir The guard heading (index into directions).
+     * @param extra_obstacle An extra obstacle to take into account on top of the grid.
+     * @param stop Set to the last position before the obstacle.
+     * @param key Set to the cell index of the stop, for loop detection.
+     * @return true If the guard stops in front of an obstacle.
+     * @return false If the guard walks off the grid.
+     */
+    bool next_stop(Coordinate pos, int dir, Coordinate extra_obstacle, Coordinate& stop, size_t& key) const {
+        int cell = stops_[(pos.first * cols_ + pos.second) * 4 + dir];
+        int limit;  // Steps until the guard is blocked or off the grid
+
+        if (cell >= 0) {
+            stop = {cell / cols_, cell % cols_};
+            limit = std::abs(stop.first - pos.first) + std::abs(stop.second - pos.second) + 1;
+        } else {
+            int dr = directions[dir].first;
+            int dc = directions[dir].second;
+            limit = (dr > 0) ? rows_ - pos.first : (dr < 0) ? pos.first + 1 : (dc > 0) ? cols_ - pos.second : pos.second + 1;
+        }
 
+        // Overlay the extra obstacle if it sits on the ray before the table's answer
+        int extra_steps = 0;
+        if (directions[dir].first != 0 && extra_obstacle.second == pos.second) {
+            extra_steps = (extra_obstacle.first - pos.first) * directions[dir].first;
+        } else if (directions[dir].second != 0 && extra_obstacle.first == pos.first) {
+            extra_steps = (extra_obstacle.second - pos.second) * directions[dir].second;
         }
 
-        // Update guard position and path
-        guard_pos.first += guard_vertical;
-        guard_pos.second += guard_horizontal;
-        guard_path[guard_pos.first].at(guard_pos.second) = 'X';
+        if (extra_steps > 0 && extra_steps < limit) {
+            stop = {extra_obstacle.first - directions[dir].first, extra_obstacle.second - directions[dir].second};
+            key = stop.first * cols_ + stop.second;
+            return true;
+        }
+
+        key = cell;
+        return cell >= 0;
     }
 
-    return guard_path;
+    /**
+     * @brief Returns the number of places a turn can happen at, for sizing VisitedStates.
+     */
+    size_t state_keys() const {
+        return rows_ * cols_;
+    }
+
+private:
+    int rows_;
+    int cols_;
+    std::vector<int> stops_;  // (cell * 4 + dir) -> stop cell, or -1 when walking off the grid
+};
+
+/**
+ * @brief Checks whether adding a single obstacle traps the guard in a loop.
+ *
+ * @tparam ObstacleMap A JumpTable or SparseMap answering next_stop queries.
+ * @param table The obstacle map for the original grid.
+ * @param trial The obstacle to add and the guard state to resume from.
+ * @param visited Scratch visited states, reset before walking.
+ * @return true If the guard gets stuck in a loop.
+ * @return false If the guard walks off the grid.
+ */
+template <typename ObstacleMap>
+bool is_loop_trial(const ObstacleMap& table, const ObstacleTrial& trial, VisitedStates& visited) {
+    GuardState state = trial.start;
+    size_t key;
+
+    visited.reset();
+
+    while (table.next_stop(state.pos, state.dir, trial.obstacle, state.pos, key)) {
+        if (visited.visit(key, state.dir)) {
+            return true;
+        }
+
+        state.dir = (state.dir + 1) % 4;
+    }
+
+    return false;
 }
 
-int part_one(Grid grid) {
+int count_guard_positions(const Grid& grid) {
     Grid guard_path = get_guard_path(grid);
     
     // for (auto line : guard_path) {
     //     std::cout << line << std::endl;
     // }
 
-    int num_positions = count_token(guard_path, 'X');
+    return count_token(guard_path, 'X');
+}
+
+int part_one(Grid grid) {
+    int num_positions = count_guard_positions(grid);
     std::cout << "Part 1) Number of guard positions: " << num_positions << std::endl;
 
     return 0;
 }
 
 
-int part_two(Grid grid) {
-    int loop_cnt = 0;
-    Grid grid_cpy;
-    std::copy(grid.begin(), grid.end(), std::back_inserter(grid_cpy));
+/**
+ * @brief Counts the obstacle trials that trap the guard in a loop, spread across worker threads.
+ *
+ * @tparam ObstacleMap A JumpTable or SparseMap answering next_stop queries.
+ * @param table The obstacle map for the original grid.
+ * @param trials The candidate obstacles and their resume states.
+ * @return int The number of obstacles that create loops.
+ */
+template <typename ObstacleMap>
+int count_loop_trials(const ObstacleMap& table, const std::vector<ObstacleTrial>& trials) {
+    std::atomic<size_t> next_trial = 0;
+    std::atomic<int> loop_cnt = 0;
+
+    unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < num_threads; t++) {
+        workers.emplace_back([&]() {
+            // Per-thread scratch state
+            VisitedStates visited(table.state_keys());
+            int thread_cnt = 0;
+
+            for (size_t k = next_trial++; k < trials.size(); k = next_trial++) {
+                if (is_loop_trial(table, trials[k], visited)) {
+                    thread_cnt += 1;
+                }
+            }
 
-    for (int i = 0; i < grid.size(); i++) {
-        std::string line = grid[i];
+            loop_cnt += thread_cnt;
+        });
+    }
 
-        for (int j = 0; j < line.size(); j++) {
-            char c = line.at(j);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return loop_cnt;
+}
 
-            if (c != '#' && c != '^') {
-                char temp = grid_cpy[i].at(j);
-                grid_cpy[i].at(j) = '#'; // Add a barrier
-                Grid guard_path = get_guard_path(grid_cpy);
+int count_loop_obstacles(const Grid& grid) {
+    std::vector<ObstacleTrial> trials = get_obstacle_trials(grid);
+    JumpTable table(grid);
 
-                if (guard_path[0].at(0) == 'O') {
-                    loop_cnt += 1;
+    return count_loop_trials(table, trials);
+}
+
+int part_two(Grid grid) {
+    int loop_cnt = count_loop_obstacles(grid);
+    std::cout << "Part 2) Number of loop obstacles: " << loop_cnt << std::endl;
+
+    return 0;
+}
+
+/**
+ * @brief Obstacles of a patrol map stored as sorted coordinate lists per row and per column.
+ *
+ * Used for very large, mostly empty maps where a Grid (or a JumpTable over it) would not fit in
+ * memory. Next-obstacle queries are answered by binary search, so memory scales with the number
+ * of obstacles instead of the map area.
+ */
+class SparseMap {
+public:
+    /**
+     * @brief Constructs a SparseMap object by streaming a map, one line at a time.
+     *
+     * @param file The stream holding the text map.
+     */
+    SparseMap(std::istream& file) : rows_(0), cols_(0), start_({-1, -1}) {
+        std::vector<Coordinate> obstacles;  // (row, col), row-major
+        std::string line;
+
+        while (std::getline(file, line)) {
+            for (size_t j = line.find_first_of("#^"); j != std::string::npos; j = line.find_first_of("#^", j + 1)) {
+                if (line[j] == '#') {
+                    obstacles.push_back({rows_, static_cast<int>(j)});
+                } else {
+                    start_ = {rows_, static_cast<int>(j)};
                 }
+            }
+
+            cols_ = std::max(cols_, static_cast<int>(line.length()));
+            rows_++;
+        }
+
+        // Row-major order gives each obstacle its id; the column lists refer back to it
+        for (size_t id = 0; id < obstacles.size(); id++) {
+            add_to_index(row_keys_, row_offsets_, row_values_, obstacles[id].first, obstacles[id].second);
+        }
+        row_offsets_.push_back(obstacles.size());
+
+        std::vector<size_t> order(obstacles.size());
+        for (size_t id = 0; id < order.size(); id++) {
+            order[id] = id;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return obstacles[a].second < obstacles[b].second;
+        });
+
+        for (size_t id : order) {
+            add_to_index(col_keys_, col_offsets_, col_values_, obstacles[id].second, obstacles[id].first);
+            col_ids_.push_back(id);
+        }
+        col_offsets_.push_back(obstacles.size());
+    }
 
-                grid_cpy[i].at(j) = temp;
+    /**
+     * @brief Finds where the guard stops when walking from a position until something is in the way.
+     *
+     * @param pos The guard position.
+     * @param dir The guard heading (index into directions).
+     * @param extra_obstacle An extra obstacle to take into account on top of the map.
+     * @param stop Set to the last position before the obstacle.
+     * @param key Set to the id of the obstacle that was hit, for loop detection.
+     * @return true If the guard stops in front of an obstacle.
+     * @return false If the guard walks off the map.
+     */
+    bool next_stop(Coordinate pos, int dir, Coordinate extra_obstacle, Coordinate& stop, size_t& key) const {
+        int dr = directions[dir].first;
+        int dc = directions[dir].second;
+        bool vertical = (dr != 0);
+        int step = vertical ? dr : dc;
+        int along = vertical ? pos.first : pos.second;
+        int across = vertical ? pos.second : pos.first;
+
+        // Walking off the map if nothing is in the way
+        int limit = (step > 0) ? (vertical ? rows_ : cols_) - along : along + 1;
+        bool blocked = false;
+
+        const std::vector<int>& keys = vertical ? col_keys_ : row_keys_;
+        auto line = std::lower_bound(keys.begin(), keys.end(), across);
+
+        if (line != keys.end() && *line == across) {
+            const std::vector<size_t>& offsets = vertical ? col_offsets_ : row_offsets_;
+            const std::vector<int>& values = vertical ? col_values_ : row_values_;
+            size_t k = line - keys.begin();
+            auto first = values.begin() + offsets[k];
+            auto last = values.begin() + offsets[k + 1];
+
+            // Nearest obstacle ahead of the guard on this row/column
+            auto hit = (step > 0) ? std::upper_bound(first, last, along) : std::lower_bound(first, last, along);
+            if (step < 0 && hit != first) {
+                --hit;
+                blocked = true;
+            } else if (step > 0 && hit != last) {
+                blocked = true;
             }
+
+            if (blocked) {
+                limit = std::abs(*hit - along);
+                key = vertical ? col_ids_[hit - values.begin()] : hit - values.begin();
+            }
+        }
+
+        // Overlay the extra obstacle if it is closer
+        int extra_steps = 0;
+        if ((vertical ? extra_obstacle.second : extra_obstacle.first) == across) {
+            extra_steps = ((vertical ? extra_obstacle.first : extra_obstacle.second) - along) * step;
+        }
+
+        if (extra_steps > 0 && extra_steps < limit) {
+            limit = extra_steps;
+            key = obstacle_count();
+            blocked = true;
+        }
+
+        if (blocked) {
+            stop = {pos.first + dr * (limit - 1), pos.second + dc * (limit - 1)};
+        }
+
+        return blocked;
+    }
+
+    /**
+     * @brief Returns the number of places a turn can happen at (every obstacle, plus one extra), for sizing VisitedStates.
+     */
+    size_t state_keys() const {
+        return obstacle_count() + 1;
+    }
+
+    size_t obstacle_count() const {
+        return row_values_.size();
+    }
+
+    int rows() const {
+        return rows_;
+    }
+
+    int cols() const {
+        return cols_;
+    }
+
+    Coordinate start() const {
+        return start_;
+    }
+
+private:
+    /**
+     * @brief Appends a value to an offsets/values index that is being filled in sorted key order.
+     */
+    static void add_to_index(std::vector<int>& keys, std::vector<size_t>& offsets, std::vector<int>& values, int key, int value) {
+        if (keys.empty() || keys.back() != key) {
+            keys.push_back(key);
+            offsets.push_back(values.size());
+        }
+        values.push_back(value);
+    }
+
+    int rows_;
+    int cols_;
+    Coordinate start_;
+
+    // Obstacle columns for each row that has any: row_keys_[k] -> row_values_[row_offsets_[k] .. row_offsets_[k+1])
+    std::vector<int> row_keys_;
+    std::vector<size_t> row_offsets_;
+    std::vector<int> row_values_;
+
+    // Obstacle rows for each column that has any, with the id of each obstacle in the row lists
+    std::vector<int> col_keys_;
+    std::vector<size_t> col_offsets_;
+    std::vector<int> col_values_;
+    std::vector<size_t> col_ids_;
+};
+
+struct GuardSegment {
+    GuardState from;
+    Coordinate to;
+};
+
+/**
+ * @brief Walks the guard across a sparse map from turn to turn.
+ *
+ * @param map The sparse obstacle map.
+ * @return std::vector<GuardSegment> The straight segments of the guard path, in walking order.
+ */
+std::vector<GuardSegment> get_guard_segments(const SparseMap& map) {
+    std::vector<GuardSegment> segments;
+    VisitedStates visited(map.state_keys());
+    GuardState state = {map.start(), 0};  // Always starts walking vertically up
+    Coordinate no_obstacle = {-1, -1};
+    Coordinate stop;
+    size_t key;
+
+    visited.reset();
+
+    while (true) {
+        bool blocked = map.next_stop(state.pos, state.dir, no_obstacle, stop, key);
+
+        if (!blocked) {
+            int dr = directions[state.dir].first;
+            int dc = directions[state.dir].second;
+            stop.first = (dr > 0) ? map.rows() - 1 : (dr < 0) ? 0 : state.pos.first;
+            stop.second = (dc > 0) ? map.cols() - 1 : (dc < 0) ? 0 : state.pos.second;
+        }
+
+        segments.push_back({state, stop});
+
+        if (!blocked || visited.visit(key, state.dir)) {
+            break;
+        }
+
+        state = {stop, (state.dir + 1) % 4};
+    }
+
+    return segments;
+}
+
+using Intervals = std::vector<std::pair<int, int>>;
+
+/**
+ * @brief Sorts and merges overlapping or touching closed intervals in place.
+ */
+void merge_intervals(Intervals& intervals) {
+    std::sort(intervals.begin(), intervals.end());
+
+    size_t n = 0;
+    for (const auto& interval : intervals) {
+        if (n > 0 && interval.first <= intervals[n - 1].second + 1) {
+            intervals[n - 1].second = std::max(intervals[n - 1].second, interval.second);
+        } else {
+            intervals[n++] = interval;
         }
     }
 
+    intervals.resize(n);
+}
+
+/**
+ * @brief A Fenwick (binary indexed) tree of counts: point updates and prefix sums in O(log n).
+ */
+class FenwickTree {
+public:
+    explicit FenwickTree(size_t size) : tree_(size + 1, 0) {}
+
+    void add(size_t index, int delta) {
+        for (size_t i = index + 1; i < tree_.size(); i += i & (~i + 1)) {
+            tree_[i] += delta;
+        }
+    }
+
+    /**
+     * @brief Returns the sum of the first count entries.
+     */
+    long long prefix(size_t count) const {
+        long long sum = 0;
+        for (size_t i = count; i > 0; i -= i & (~i + 1)) {
+            sum += tree_[i];
+        }
+        return sum;
+    }
+
+private:
+    std::vector<long long> tree_;
+};
+
+/**
+ * @brief Counts the cells where a vertical run crosses a horizontal one, i.e. the cells both sets of runs cover.
+ *
+ * Sweeps down the rows, keeping the columns of the vertical runs that span the current row in a Fenwick tree, so
+ * each horizontal run is a range query: O((H + V) log V) for H horizontal and V vertical runs, rather than a check
+ * per pair. Runs must be merged (no two runs of one row or one column overlap).
+ */
+long long count_crossings(const std::map<int, Intervals>& row_runs, const std::map<int, Intervals>& col_runs) {
+    struct RunEvent {
+        int row;          // The row the change applies from
+        int delta;        // +1 when a vertical run starts, -1 once it has ended
+        size_t col_index; // Index of the run's column in cols
+    };
+
+    std::vector<int> cols;
+    std::vector<RunEvent> events;
+
+    for (const auto& [col, runs] : col_runs) {
+        for (const auto& run : runs) {
+            events.push_back({run.first, 1, cols.size()});
+            events.push_back({run.second + 1, -1, cols.size()});
+        }
+        cols.push_back(col);
+    }
+
+    std::sort(events.begin(), events.end(), [](const RunEvent& a, const RunEvent& b) { return a.row < b.row; });
+
+    FenwickTree active(cols.size());
+    long long crossings = 0;
+    size_t next_event = 0;
+
+    for (const auto& [row, runs] : row_runs) {
+        for (; next_event < events.size() && events[next_event].row <= row; next_event++) {
+            active.add(events[next_event].col_index, events[next_event].delta);
+        }
+
+        for (const auto& run : runs) {
+            size_t first = std::lower_bound(cols.begin(), cols.end(), run.first) - cols.begin();
+            size_t last = std::upper_bound(cols.begin(), cols.end(), run.second) - cols.begin();
+            crossings += active.prefix(last) - active.prefix(first);
+        }
+    }
+
+    return crossings;
+}
+
+int part_one_sparse(const SparseMap& map) {
+    // Visited cells as merged intervals: horizontal runs per row, vertical runs per column
+    std::map<int, Intervals> row_runs;
+    std::map<int, Intervals> col_runs;
+
+    row_runs[map.start().first].push_back({map.start().second, map.start().second});
+
+    for (const GuardSegment& segment : get_guard_segments(map)) {
+        Coordinate from = segment.from.pos;
+
+        if (directions[segment.from.dir].first != 0) {
+            col_runs[from.second].push_back(std::minmax(from.first, segment.to.first));
+        } else {
+            row_runs[from.first].push_back(std::minmax(from.second, segment.to.second));
+        }
+    }
+
+    long long num_positions = 0;
+
+    for (auto& [row, runs] : row_runs) {
+        merge_intervals(runs);
+        for (const auto& run : runs) {
+            num_positions += run.second - run.first + 1;
+        }
+    }
+
+    for (auto& [col, runs] : col_runs) {
+        merge_intervals(runs);
+        for (const auto& run : runs) {
+            num_positions += run.second - run.first + 1;
+        }
+    }
+
+    // Don't count cells twice where a vertical run crosses a horizontal one
+    num_positions -= count_crossings(row_runs, col_runs);
+
+    std::cout << "Part 1) Number of guard positions: " << num_positions << std::endl;
+
+    return 0;
+}
+
+int part_two_sparse(const SparseMap& map) {
+    std::vector<ObstacleTrial> trials;
+    std::unordered_set<long long> seen;  // Scales with the path length, not the map area
+    auto cell_key = [&](Coordinate pos) { return static_cast<long long>(pos.first) * map.cols() + pos.second; };
+
+    seen.insert(cell_key(map.start()));  // Can't place an obstacle on the guard
+
+    for (const GuardSegment& segment : get_guard_segments(map)) {
+        GuardState state = segment.from;
+
+        while (state.pos != segment.to) {
+            Coordinate next_pos = {state.pos.first + directions[state.dir].first, state.pos.second + directions[state.dir].second};
+
+            if (seen.insert(cell_key(next_pos)).second) {
+                trials.push_back({next_pos, state});
+            }
+
+            state.pos = next_pos;
+        }
+    }
+
+    int loop_cnt = count_loop_trials(map, trials);
     std::cout << "Part 2) Number of loop obstacles: " << loop_cnt << std::endl;
 
     return 0;
 }
 
-int main() {
-    std::ifstream file("../data/day6.txt");
+/**
+ * @brief Reads the patrol map from a file into a Grid.
+ */
+Grid read_grid(const std::string& path) {
+    std::ifstream file(path);
     std::string line;
     Grid grid;
 
@@ -201,8 +861,59 @@ int main() {
         grid.push_back(line);
     }
 
-    part_one(grid); // Count guard positions
-    part_two(grid); // Count obstacles that create loops (overcounting somehow)
+    return grid;
+}
 
-    return 0;
+/**
+ * @brief Loads the patrol map from the binary cache, or parses the text and writes the cache (see input_cache.h).
+ *
+ * The cache holds the rows packed back to back, with their offsets.
+ */
+Grid load_grid(const std::string& path, bool use_cache) {
+    return load_cached(path, "day6", use_cache, read_grid,
+                       [](const Grid& grid, CacheWriter& writer) { writer.put_lists(grid); },
+                       [](CacheReader& reader) {
+                           Grid grid;
+                           reader.get_lists<char>([&](std::span<const char> row) { grid.emplace_back(row.begin(), row.end()); });
+                           return grid;
+                       });
+}
+
+int main(int argc, char* argv[]) {
+    const std::string input_path = "../data/day6.txt";
+    bool use_cache = cache_enabled(argc, argv);
+    auto load = [use_cache](const std::string& path) { return load_grid(path, use_cache); };
+
+    int status;
+    if (run_service("day6", input_path, argc, argv, load,
+                    [](Grid& grid, int part) {
+                        return std::to_string((part == 1) ? count_guard_positions(grid) : count_loop_obstacles(grid));
+                    }, status)) {
+        return status;
+    }
+
+    Benchmark bench("day6", argc, argv);
+    bool sparse = false;
+
+    for (int i = 1; i < argc; i++) {
+        sparse = sparse || std::string(argv[i]) == "--sparse";
+    }
+
+    // Huge, mostly empty maps never get loaded as a full grid
+    if (sparse) {
+        SparseMap map = bench.phase("parse_sparse", [&] {
+            std::ifstream file(input_path);
+            return SparseMap(file);
+        });
+        bench.phase("part_one_sparse", [&] { return part_one_sparse(map); });
+        bench.phase("part_two_sparse", [&] { return part_two_sparse(map); });
+        return bench.finish();
+    }
+
+    Grid grid = bench.phase("parse", [&] { return load(input_path); });
+
+    bench.phase("part_one", [&] { return part_one(grid); }); // Count guard positions
+    bench.phase("part_two", [&] { return part_two(grid); }); // Count obstacles that create loops
+
+    return bench.finish();
 }
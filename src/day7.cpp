@@ -3,23 +3,53 @@
 #include <fstream>
 #include <vector>
 #include <iterator>
+#include <string>
+#include <array>
+#include <limits>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <cstdint>
+#include <memory_resource>
+
+#include "arena.h"
+#include "benchmark.h"
+#include "input_cache.h"
+#include "service.h"
 
 /**
- * @brief A class to iterate over the Cartesian product of a vector of characters repeated a specified number of times.
+ * @brief A class to iterate over the Cartesian product of a vector of elements repeated a specified number of times.
+ * 
+ * Combinations are produced in lexicographic order, so consecutive combinations share a prefix. The current
+ * combination is updated in place (nothing is allocated per step), and the iterator reports the first position
+ * that changed so callers can cache work done on the shared prefix. Its state is allocated from a std::pmr
+ * resource, so callers can keep it in a scratch arena.
+ * 
+ * @tparam T The element type (e.g. operator characters).
  */
+template <typename T>
 class ProductIterator {
 public:
     /**
      * @brief Constructs a ProductIterator object.
      * 
-     * @param vec The vector of characters to iterate over.
-     * @param repeat The number of times to repeat the vector in the Cartesian product.
+     * @param vec The elements to iterate over (must outlive the iterator).
+     * @param repeat The number of times to repeat the elements in the Cartesian product.
+     * @param resource Where to allocate the iterator state (the default heap resource if not given).
      */
-    ProductIterator(const std::vector<char>& vec, int repeat)
-        : vec_(vec), repeat_(repeat), indices_(repeat, 0), end_(false) {
+    ProductIterator(std::span<const T> vec, int repeat, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : vec_(vec), repeat_(repeat), indices_(repeat, 0, resource), combo_(resource), changed_from_(0), end_(false) {
         // Initialize iterator at the end if the input vector is empty
         if (vec.empty()) {
             end_ = true;
+        } else {
+            combo_.assign(repeat, vec[0]);
         }
     }
 
@@ -40,27 +70,37 @@ public:
         /**
          * @brief Dereferences the iterator to get the current product combination.
          * 
-         * @return std::vector<char> The current product combination.
+         * @return const std::pmr::vector<T>& The current product combination (valid until the iterator moves).
          */
-        std::vector<char> operator*() const {
-            std::vector<char> result;
-            for (int i : parent_->indices_) {
-                result.push_back(parent_->vec_[i]);
-            }
-            return result;
+        const std::pmr::vector<T>& operator*() const {
+            return parent_->combo_;
         }
 
         /**
-         * @brief Pre-increment operator to move the iterator to the next product combination.
+         * @brief Returns the first position that differs from the previous combination.
+         * 
+         * Positions before this one are unchanged since the last step (0 for the first combination).
+         * 
+         * @return size_t The first changed position.
+         */
+        size_t changed_from() const {
+            return parent_->changed_from_;
+        }
+
+        /**
+         * @brief Skips every remaining combination that shares the current prefix up to and including a position.
+         * 
+         * Useful for pruning: if the prefix [0, pos] can't lead anywhere, move straight to the next prefix.
          * 
+         * @param pos The last position of the prefix to skip.
          * @return Iterator& A reference to the updated iterator.
          */
-        Iterator& operator++() {
+        Iterator& skip(size_t pos) {
             if (end_) return *this;
 
-            // Find the rightmost index that can be incremented
+            // Find the rightmost index (up to pos) that can be incremented
             int i;
-            for (i = parent_->repeat_ - 1; i >= 0; --i) {
+            for (i = static_cast<int>(pos); i >= 0; --i) {
                 if (parent_->indices_[i] != parent_->vec_.size() - 1) {
                     break;
                 }
@@ -74,15 +114,33 @@ public:
 
             // Increment this index
             parent_->indices_[i]++;
+            parent_->combo_[i] = parent_->vec_[parent_->indices_[i]];
 
             // Zero out any indices to the right of this index
             for (int j = i + 1; j < parent_->repeat_; ++j) {
                 parent_->indices_[j] = 0;
+                parent_->combo_[j] = parent_->vec_[0];
             }
 
+            parent_->changed_from_ = i;
+
             return *this;
         }
 
+        /**
+         * @brief Pre-increment operator to move the iterator to the next product combination.
+         * 
+         * @return Iterator& A reference to the updated iterator.
+         */
+        Iterator& operator++() {
+            if (parent_->repeat_ == 0) {
+                end_ = true;  // The single empty combination
+                return *this;
+            }
+
+            return skip(parent_->repeat_ - 1);
+        }
+
         /**
          * @brief Inequality comparison operator for iterators.
          * 
@@ -105,7 +163,7 @@ public:
      * @return Iterator An iterator to the beginning.
      */
     Iterator begin() {
-        return Iterator(this);
+        return Iterator(this, end_);
     }
 
     /**
@@ -118,92 +176,764 @@ public:
     }
 
 private:
-    const std::vector<char>& vec_;
+    std::span<const T> vec_;
     int repeat_;
-    std::vector<int> indices_;
+    std::pmr::vector<size_t> indices_;
+    std::pmr::vector<T> combo_;
+    size_t changed_from_;
     bool end_;
 };
 
 /**
- * @brief Returns an iterator to the end of the Cartesian product.
+ * @brief Returns a ProductIterator over the Cartesian product of a set of elements repeated a number of times.
+ * 
+ * @param vec The elements to iterate over.
+ * @param repeat The number of times to repeat the elements.
+ * @param resource Where to allocate the iterator state.
+ * @return ProductIterator<T> The product to iterate over.
+ */
+template <typename T>
+ProductIterator<T> product(std::span<const T> vec, int repeat, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    return ProductIterator<T>(vec, repeat, resource);
+}
+
+/**
+ * @brief Powers of ten that fit in an unsigned 64-bit integer, used to concatenate numbers arithmetically.
+ */
+constexpr std::array<unsigned long int, 20> powers_of_ten = [] {
+    std::array<unsigned long int, 20> powers{};
+    unsigned long int power = 1;
+    for (unsigned long int& p : powers) {
+        p = power;
+        power *= 10;
+    }
+    return powers;
+}();
+
+/**
+ * @brief The + operator.
+ */
+struct Add {
+    static constexpr char symbol = '+';
+
+    /**
+     * @brief Computes total + operand.
+     * 
+     * @return false If the result overflows.
+     */
+    static constexpr bool apply(unsigned long int total, unsigned long int operand, unsigned long int& out) {
+        return !__builtin_add_overflow(total, operand, &out);
+    }
+
+    /**
+     * @brief Finds the total that gives target once the operand is added.
+     * 
+     * @return false If there is no such total.
+     */
+    static constexpr bool undo(unsigned long int target, unsigned long int operand, unsigned long int& out) {
+        out = target - operand;
+        return target >= operand;
+    }
+
+    /**
+     * @brief Checks if target is reached whatever the total is.
+     */
+    static constexpr bool absorbs(unsigned long int, unsigned long int) {
+        return false;
+    }
+};
+
+/**
+ * @brief The * operator.
+ */
+struct Multiply {
+    static constexpr char symbol = '*';
+
+    static constexpr bool apply(unsigned long int total, unsigned long int operand, unsigned long int& out) {
+        return !__builtin_mul_overflow(total, operand, &out);
+    }
+
+    static constexpr bool undo(unsigned long int target, unsigned long int operand, unsigned long int& out) {
+        if (operand == 0) {
+            return false;
+        }
+        out = target / operand;
+        return target % operand == 0;
+    }
+
+    static constexpr bool absorbs(unsigned long int target, unsigned long int operand) {
+        return operand == 0 && target == 0;  // Anything times zero
+    }
+};
+
+/**
+ * @brief The || (concatenation) operator, written as | in the operator sets.
+ */
+struct Concat {
+    static constexpr char symbol = '|';
+
+    /**
+     * @brief Returns the smallest power of ten greater than a number, i.e. the shift used to concatenate it.
+     * 
+     * @param value The number to be concatenated on the right.
+     * @return unsigned long int 10^(number of digits in value), or 0 if that doesn't fit.
+     */
+    static constexpr unsigned long int shift(unsigned long int value) {
+        size_t digits = 1;
+        while (digits < powers_of_ten.size() && powers_of_ten[digits] <= value) {
+            digits++;
+        }
+        return (digits < powers_of_ten.size()) ? powers_of_ten[digits] : 0;
+    }
+
+    static constexpr bool apply(unsigned long int total, unsigned long int operand, unsigned long int& out) {
+        unsigned __int128 wide = static_cast<unsigned __int128>(total) * shift(operand) + operand;
+        out = static_cast<unsigned long int>(wide);
+        return shift(operand) != 0 && wide <= std::numeric_limits<unsigned long int>::max();
+    }
+
+    static constexpr bool undo(unsigned long int target, unsigned long int operand, unsigned long int& out) {
+        unsigned long int s = shift(operand);
+        if (s == 0) {
+            return false;
+        }
+        out = target / s;
+        return target % s == operand;
+    }
+
+    static constexpr bool absorbs(unsigned long int, unsigned long int) {
+        return false;
+    }
+};
+
+/**
+ * @brief Applies a single operator, picked from a compile-time operator set, to a running total.
+ * 
+ * @tparam Ops The operator set.
+ * @param op The symbol of the operator to apply.
+ * @param total The running total (left operand).
+ * @param operand The right operand.
+ * @param out Set to the new total.
+ * @return false If the operator overflows (or isn't in the set).
+ */
+template <typename... Ops>
+bool apply_operator(char op, unsigned long int total, unsigned long int operand, unsigned long int& out) {
+    bool ok = false;
+    ((op == Ops::symbol ? (ok = Ops::apply(total, operand, out), true) : false) || ...);
+    return ok;
+}
+
+/**
+ * @brief Checks if a given combination of operands and operators results in the specified result,
+ * by trying every combination of operators (reference implementation for is_valid_equation).
+ * 
+ * Partial totals are kept on a stack, so each step only re-evaluates the operators that changed, and
+ * a prefix whose total already overshoots the result is skipped as a whole.
+ * 
+ * @tparam Ops The operator set (e.g. Add, Multiply, Concat).
+ * @param operands The list of operands.
+ * @param result The expected result of the equation.
+ * @param scratch Where to allocate the partial totals and iterator state (e.g. a ScratchArena reset per equation).
+ * @return true If the combination of operands and operators results in the specified result.
+ * @return false Otherwise.
+ */
+template <typename... Ops>
+bool is_valid_equation_exhaustive(const std::vector<int>& operands, unsigned long int result,
+                                  std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    static constexpr std::array<char, sizeof...(Ops)> operators = {Ops::symbol...};
+    std::pmr::vector<unsigned long int> partial(operands.size(), scratch);  // partial[k] = total after the first k+1 operands
+
+    if (operands.empty()) {
+        return false;
+    }
+
+    partial[0] = operands[0];
+    auto combos = product<char>(operators, operands.size() - 1, scratch);
+    auto it = combos.begin();
+
+    while (it != combos.end()) {
+        const std::pmr::vector<char>& combo = *it;
+        bool overshoot = false;
+
+        for (size_t k = it.changed_from(); k < combo.size(); k++) {
+            if (!apply_operator<Ops...>(combo[k], partial[k], operands[k + 1], partial[k + 1]) || partial[k + 1] > result) {
+                it.skip(k);
+                overshoot = true;
+                break;
+            }
+        }
+
+        if (overshoot) {
+            continue;
+        }
+
+        if (partial.back() == result) {
+            return true;
+        }
+
+        ++it;
+    }
+
+    return false;
+}
+
+template <typename... Ops>
+constexpr bool can_reach(std::span<const int> operands, size_t count, unsigned long int target, const std::atomic<bool>* cancel = nullptr);
+
+/**
+ * @brief Undoes one operator on the last of the leading operands and checks if the rest can reach what's left.
+ * 
+ * @tparam Op The operator to undo.
+ * @tparam Ops The full operator set, for the remaining operands.
+ */
+template <typename Op, typename... Ops>
+constexpr bool undo_and_reach(std::span<const int> operands, size_t count, unsigned long int target, const std::atomic<bool>* cancel) {
+    unsigned long int last = operands[count - 1];
+    unsigned long int prev;
+
+    return Op::absorbs(target, last) || (Op::undo(target, last, prev) && can_reach<Ops...>(operands, count - 1, prev, cancel));
+}
+
+/**
+ * @brief Checks if the first operands can be combined into a target, working backwards from the last operand.
+ * 
+ * Each operator is undone from the right: subtract for +, exact divide for *, and strip the decimal suffix for ||.
+ * A branch is dropped as soon as the operator can't be undone, so only a handful of branches survive.
+ * Operators are tried in the order given, so the most selective ones should come first. Nothing is allocated,
+ * and the search can run at compile time (without a cancel flag).
  * 
- * @return Iterator An iterator to the end.
+ * @tparam Ops The operator set (e.g. Concat, Multiply, Add).
+ * @param operands The list of operands.
+ * @param count The number of leading operands to combine.
+ * @param target The value the leading operands must combine to.
+ * @param cancel Optional flag to give up early on (e.g. once another thread has proven the equation valid).
+ * @return true If some combination of operators gives the target.
+ * @return false Otherwise (or if cancelled).
  */
-ProductIterator product(const std::vector<char>& vec, int repeat) {
-    return ProductIterator(vec, repeat);
+template <typename... Ops>
+constexpr bool can_reach(std::span<const int> operands, size_t count, unsigned long int target, const std::atomic<bool>* cancel) {
+    if (count == 1) {
+        return target == static_cast<unsigned long int>(operands[0]);
+    }
+
+    if (cancel && cancel->load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    return (undo_and_reach<Ops, Ops...>(operands, count, target, cancel) || ...);
 }
 
 /**
  * @brief Checks if a given combination of operands and operators results in the specified result.
  * 
+ * @tparam Ops The operator set (e.g. Concat, Multiply, Add).
  * @param operands The list of operands.
  * @param result The expected result of the equation.
- * @return true If the combination of operands and operators (+, *, ||) results in the specified result.
+ * @return true If the combination of operands and operators results in the specified result.
  * @return false Otherwise.
  */
-bool is_valid_equation(std::vector<int> operands, unsigned long int result) {
-    unsigned long int total;
-    size_t pos;
-    std::vector<char> operators = {'+', '*', '|'};
-    bool is_valid = false;
-
-    for (const auto& combo : product(operators, operands.size() - 1)) {
-        total = operands[0];
-        pos = 1;
-
-        for (char c : combo) {
-            if (c == '+') {
-                total += operands[pos];
-            } else if (c == '*') {
-                total *= operands[pos];
-            } else if (c == '|') {
-                total = std::stoul(std::to_string(total) + std::to_string(operands[pos]));
+template <typename... Ops>
+constexpr bool is_valid_equation(std::span<const int> operands, unsigned long int result) {
+    return !operands.empty() && can_reach<Ops...>(operands, operands.size(), result);
+}
+
+// Golden checks on the puzzle's example equations, solved at compile time
+static_assert(is_valid_equation<Multiply, Add>(std::array{10, 19}, 190));
+static_assert(is_valid_equation<Multiply, Add>(std::array{81, 40, 27}, 3267));
+static_assert(!is_valid_equation<Multiply, Add>(std::array{15, 6}, 156));
+static_assert(is_valid_equation<Concat, Multiply, Add>(std::array{15, 6}, 156));
+static_assert(is_valid_equation<Concat, Multiply, Add>(std::array{6, 8, 6, 15}, 7290));
+static_assert(!is_valid_equation<Concat, Multiply, Add>(std::array{9, 7, 18, 13}, 21037));
+
+/**
+ * @brief Checks an equation against a compile-time operator set, with the solver picked at runtime.
+ * 
+ * The exhaustive solver's scratch state comes from an arena owned by the calling thread and reset per check, so
+ * workers never contend on the global heap.
+ */
+template <typename... Ops>
+bool check_equation(const std::vector<int>& operands, unsigned long int result, bool exhaustive) {
+    if (!exhaustive) {
+        return is_valid_equation<Ops...>(operands, result);
+    }
+
+    thread_local ScratchArena arena;
+    arena.reset();
+    return is_valid_equation_exhaustive<Ops...>(operands, result, arena.resource());
+}
+
+/**
+ * @brief A thread pool where each worker has its own task deque and steals from the others when it runs dry.
+ * 
+ * Tasks submitted from inside a worker go to that worker's deque (popped LIFO, so a task's subtasks run
+ * while still hot), while idle workers steal the oldest tasks (FIFO) from the front of other deques.
+ * This keeps every core busy even when task costs vary by orders of magnitude.
+ * 
+ * Tasks are plain values (e.g. a pointer and a few numbers) run as task.run(pool), and the deques are ring buffers
+ * that keep their capacity, so submitting and running tasks makes no heap calls once the deques have grown.
+ * 
+ * @tparam Task The task type: copyable, default-constructible, with a void run(WorkStealingPool<Task>&) const.
+ */
+template <typename Task>
+class WorkStealingPool {
+public:
+
+    /**
+     * @brief Constructs a WorkStealingPool object and starts its workers.
+     * 
+     * @param num_threads The number of worker threads.
+     */
+    WorkStealingPool(unsigned int num_threads)
+        : queued_(0), pending_(0), sleeping_(0), next_queue_(0), stop_(false) {
+        for (unsigned int i = 0; i < num_threads; i++) {
+            queues_.push_back(std::make_unique<TaskQueue>());
+        }
+        for (unsigned int i = 0; i < num_threads; i++) {
+            threads_.emplace_back(&WorkStealingPool::run, this, i);
+        }
+    }
+
+    /**
+     * @brief Waits for outstanding tasks and stops the workers.
+     */
+    ~WorkStealingPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        task_cv_.notify_all();
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    /**
+     * @brief Submits a task, onto the calling worker's own deque if called from inside a task.
+     * 
+     * @param task The task to run.
+     */
+    void submit(const Task& task) {
+        size_t index = (current_pool_ == this) ? current_worker_ : next_queue_++ % queues_.size();
+        pending_++;
+
+        // Count the task before publishing it, so a worker popping it right away can't take queued_ below zero
+        queued_++;
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->push_back(task);
+        }
+
+        // Only take the pool-wide lock when a worker is asleep. A worker counts itself in sleeping_ before checking
+        // queued_, so either it sees this task or this sees it asleep (both are sequentially consistent).
+        if (sleeping_ > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_cv_.notify_one();
+        }
+    }
+
+    /**
+     * @brief Blocks until every submitted task, including tasks submitted by other tasks, has finished.
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+private:
+    /**
+     * @brief A worker's deque, as a ring buffer whose length is a power of two and that only ever grows.
+     */
+    struct TaskQueue {
+        std::mutex mutex;
+        std::vector<Task> tasks = std::vector<Task>(64);
+        size_t head = 0;  // Index of the oldest task
+        size_t size = 0;
+
+        void push_back(const Task& task) {
+            if (size == tasks.size()) {
+                std::vector<Task> larger(2 * tasks.size());
+                for (size_t i = 0; i < size; i++) {
+                    larger[i] = tasks[(head + i) & (tasks.size() - 1)];
+                }
+                tasks.swap(larger);
+                head = 0;
             }
+            tasks[(head + size++) & (tasks.size() - 1)] = task;
+        }
 
-            if (total > result) {
-                break;
+        Task pop_back() {
+            return tasks[(head + --size) & (tasks.size() - 1)];
+        }
+
+        Task pop_front() {
+            Task task = tasks[head];
+            head = (head + 1) & (tasks.size() - 1);
+            size--;
+            return task;
+        }
+    };
+
+    /**
+     * @brief Takes a task from the worker's own deque, or steals one from another worker.
+     */
+    bool take_task(size_t self, Task& task) {
+        for (size_t k = 0; k < queues_.size(); k++) {
+            TaskQueue& queue = *queues_[(self + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (queue.size > 0) {
+                task = (k == 0) ? queue.pop_back() : queue.pop_front();
+                queued_--;
+                return true;
             }
-            pos++;
         }
-        
-        if (total == result) {
-            is_valid = true;
-            break;
+
+        return false;
+    }
+
+    void run(size_t self) {
+        current_pool_ = this;
+        current_worker_ = self;
+        Task task;
+
+        while (true) {
+            if (take_task(self, task)) {
+                task.run(*this);
+
+                if (--pending_ == 0) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    done_cv_.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_++;
+            task_cv_.wait(lock, [this] { return stop_ || queued_ > 0; });
+            sleeping_--;
+            if (stop_) {
+                return;
+            }
         }
     }
 
-    return is_valid;
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_;   // Tasks sitting in a deque
+    std::atomic<size_t> pending_;  // Tasks submitted but not finished
+    std::atomic<size_t> sleeping_; // Workers waiting on task_cv_
+    std::atomic<size_t> next_queue_;
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable task_cv_;
+    std::condition_variable done_cv_;
+
+    static thread_local WorkStealingPool* current_pool_;
+    static thread_local size_t current_worker_;
+};
+
+template <typename Task>
+thread_local WorkStealingPool<Task>* WorkStealingPool<Task>::current_pool_ = nullptr;
+template <typename Task>
+thread_local size_t WorkStealingPool<Task>::current_worker_ = 0;
+
+/**
+ * @brief A parsed equation line, with flags set once it is proven valid under each operator set.
+ */
+struct Equation {
+    unsigned long int result;
+    std::vector<int> operands;
+    std::atomic<bool> valid_no_concat{false};  // Valid with (+, *)
+    std::atomic<bool> valid{false};            // Valid with (+, *, ||)
+};
+
+/**
+ * @brief What an EquationTask checks.
+ */
+enum class EquationCheck : uint8_t {
+    NoConcat,           // Search with (+, *), setting valid_no_concat
+    NoConcatImplying,   // Search with (+, *), setting valid_no_concat and valid (a superset of the operators)
+    Concat,             // Search with (+, *, ||), setting valid
+    Exhaustive,         // Try every combination with (+, *), then with (+, *, ||)
+    ExhaustiveNoConcat  // Try every combination with (+, *) only
+};
+
+/**
+ * @brief A unit of work on the pool: one (sub)search of one equation, small enough to queue by value.
+ */
+struct EquationTask {
+    Equation* equation = nullptr;
+    unsigned long int target = 0;  // The value the leading operands must combine to
+    size_t count = 0;              // The number of leading operands to combine
+    EquationCheck check = EquationCheck::NoConcat;
+
+    void run(WorkStealingPool<EquationTask>& pool) const;
+};
+
+using EquationPool = WorkStealingPool<EquationTask>;
+
+// Searches with more leading operands than this are split into one task per operator
+const size_t split_operands = 10;
+
+/**
+ * @brief Searches for a valid operator combination on the pool, splitting long equations into subtrees.
+ * 
+ * Every subtree checks the found flag before doing any work, so the rest of the search for a line is
+ * cancelled as soon as one subtree proves it valid.
+ * 
+ * @tparam Ops The operator set.
+ * @param pool The pool to submit subtrees to.
+ * @param task The search: its equation, target and count of leading operands (subtrees keep its check).
+ * @param found Set once the equation is proven valid (and checked to cancel the search).
+ * @param implied Optional flag that is also set, for operator sets that are a superset of this one.
+ */
+template <typename... Ops>
+void search_equation(EquationPool& pool, const EquationTask& task, std::atomic<bool>& found, std::atomic<bool>* implied) {
+    const Equation& equation = *task.equation;
+    size_t count = task.count;
+    unsigned long int target = task.target;
+
+    if (found) {
+        return;
+    }
+
+    if (count <= split_operands) {
+        if (can_reach<Ops...>(equation.operands, count, target, &found)) {
+            found = true;
+            if (implied) {
+                *implied = true;
+            }
+        }
+        return;
+    }
+
+    // Undo each operator on the last operand here and hand the remaining subtrees to the pool
+    unsigned long int last = equation.operands[count - 1];
+    auto split = [&]<typename Op>() {
+        unsigned long int prev;
+
+        if (Op::absorbs(target, last)) {
+            found = true;
+            if (implied) {
+                *implied = true;
+            }
+        } else if (Op::undo(target, last, prev)) {
+            pool.submit({task.equation, prev, count - 1, task.check});
+        }
+    };
+
+    (split.template operator()<Ops>(), ...);
 }
 
 /**
- * @brief The main function reads input from a file, checks for valid equations, and prints the sum of valid results
+ * @brief Runs the check the task names on its equation.
+ */
+void EquationTask::run(EquationPool& pool) const {
+    switch (check) {
+        case EquationCheck::NoConcat:
+            search_equation<Multiply, Add>(pool, *this, equation->valid_no_concat, nullptr);
+            break;
+        case EquationCheck::NoConcatImplying:
+            search_equation<Multiply, Add>(pool, *this, equation->valid_no_concat, &equation->valid);
+            break;
+        case EquationCheck::Concat:
+            search_equation<Concat, Multiply, Add>(pool, *this, equation->valid, nullptr);
+            break;
+        case EquationCheck::Exhaustive:
+        case EquationCheck::ExhaustiveNoConcat:
+            if (check_equation<Multiply, Add>(equation->operands, equation->result, true)) {
+                equation->valid_no_concat = true;
+                equation->valid = true;  // Still valid once concatenation is allowed
+            } else if (check == EquationCheck::Exhaustive &&
+                       check_equation<Concat, Multiply, Add>(equation->operands, equation->result, true)) {
+                equation->valid = true;
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Reads the equations from a file, one "result: operands..." line each.
  * 
- * @return int Exit status of the program.
+ * @param path The path to the input file.
+ * @return std::deque<Equation> The equations, with both validity flags cleared.
  */
-int main() {
-    std::ifstream file("../data/day7.txt");
+std::deque<Equation> read_equations(const std::string& path) {
+    std::ifstream file(path);
     std::string line;
     std::string temp_str;
     int temp_int;
-    unsigned long int result;
-    unsigned long int total;
+    std::istringstream iss;  // Reused for every line, like temp_str
+    ScratchArena arena;
+    std::deque<Equation> equations;  // Doesn't move elements, so tasks can hold references
 
     while (std::getline(file, line)) {
-        std::istringstream iss(line);
+        iss.clear();
+        iss.str(line);
         iss >> temp_str;
-        result = std::stoul(temp_str.substr(0, temp_str.length()-1));
-        std::vector<int> operands;
+        Equation& equation = equations.emplace_back();
+        equation.result = std::stoul(temp_str.substr(0, temp_str.length()-1));
+
+        // Collect the operands in the arena, then store them with a single allocation
+        arena.reset();
+        std::pmr::vector<int> operands(arena.resource());
 
         while (iss >> temp_int) {
             operands.push_back(temp_int);
         }
 
-        if (is_valid_equation(operands, result)) {
-            total += result;
+        equation.operands.assign(operands.begin(), operands.end());
+    }
+
+    return equations;
+}
+
+/**
+ * @brief Loads the equations from the binary cache, or parses the text and writes the cache (see input_cache.h).
+ * 
+ * The cache holds the results as one array and the operands CSR-style.
+ * 
+ * @param path The path to the input file.
+ * @param use_cache False to always parse the text.
+ * @return std::deque<Equation> The equations, with both validity flags cleared.
+ */
+std::deque<Equation> load_equations(const std::string& path, bool use_cache) {
+    return load_cached(path, "day7", use_cache, read_equations,
+                       [](const std::deque<Equation>& equations, CacheWriter& writer) {
+                           std::vector<uint64_t> results;
+                           for (const Equation& equation : equations) {
+                               results.push_back(equation.result);
+                           }
+
+                           writer.put_array(results);
+                           writer.put_lists(equations, &Equation::operands);
+                       },
+                       [](CacheReader& reader) {
+                           std::deque<Equation> equations;
+                           for (uint64_t result : reader.get_array<uint64_t>()) {
+                               equations.emplace_back().result = result;
+                           }
+
+                           size_t i = 0;
+                           reader.get_lists<int>([&](std::span<const int> operands) {
+                               if (i < equations.size()) {
+                                   equations[i].operands.assign(operands.begin(), operands.end());
+                               }
+                               i++;
+                           });
+
+                           // One operand list per result, or the cache is rebuilt from the text
+                           if (i != equations.size()) {
+                               reader.fail();
+                           }
+                           return equations;
+                       });
+}
+
+/**
+ * @brief Checks every equation on a WorkStealingPool and sums the results of the valid ones.
+ * 
+ * @param pool The pool to run the checks on (reused across calls, e.g. by a resident service).
+ * @param equations The equations to check. Their validity flags are reset and then filled in.
+ * @param exhaustive Whether to try every operator combination (one task per line) instead of searching backwards.
+ * @param part 1 to check only with (+, *), 2 to check only with (+, *, ||), or 0 to check both.
+ * @return std::pair<unsigned long int, unsigned long int> The sums of valid results with (+, *) and with (+, *, ||)
+ * (0 for a set that wasn't checked).
+ */
+std::pair<unsigned long int, unsigned long int> solve_equations(EquationPool& pool, std::deque<Equation>& equations,
+                                                                bool exhaustive, int part = 0) {
+    unsigned long int total = 0;
+    unsigned long int total_no_concat = 0;
+    bool check_no_concat = (part != 2);
+    bool check_concat = (part != 1);
+
+    for (Equation& equation : equations) {
+        equation.valid_no_concat = false;
+        equation.valid = false;
+
+        if (equation.operands.empty()) {
+            continue;
+        }
+
+        size_t count = equation.operands.size();
+
+        if (exhaustive) {
+            pool.submit({&equation, equation.result, count,
+                         check_concat ? EquationCheck::Exhaustive : EquationCheck::ExhaustiveNoConcat});
+            continue;
+        }
+
+        // A line valid with (+, *) is also valid with (+, *, ||), which cancels the second search
+        if (check_no_concat) {
+            pool.submit({&equation, equation.result, count,
+                         check_concat ? EquationCheck::NoConcatImplying : EquationCheck::NoConcat});
+        }
+        if (check_concat) {
+            pool.submit({&equation, equation.result, count, EquationCheck::Concat});
         }
     }
 
-    std::cout << "Total sum of valid equation results: " << total << std::endl;
+    pool.wait();
+
+    for (const Equation& equation : equations) {
+        if (check_no_concat && equation.valid_no_concat) {
+            total_no_concat += equation.result;
+        }
+        if (check_concat && equation.valid) {
+            total += equation.result;
+        }
+    }
+
+    return std::make_pair(total_no_concat, total);
+}
+
+/**
+ * @brief The main function reads input from a file, checks for valid equations, and prints the sum of valid results
+ * 
+ * Equations are checked in parallel on a WorkStealingPool. Pass --exhaustive to check equations by trying
+ * every operator combination instead (one task per line), or --bench to time each phase (see benchmark.h).
+ * With --serve / --query, the equations stay loaded in a resident service (see service.h). Parsed equations are
+ * cached next to the input (see input_cache.h); pass --no-cache to always parse the text.
+ * 
+ * @return int Exit status of the program.
+ */
+int main(int argc, char* argv[]) {
+    const std::string input_path = "../data/day7.txt";
+    bool exhaustive = false;
+    bool use_cache = cache_enabled(argc, argv);
+    auto load = [use_cache](const std::string& path) { return load_equations(path, use_cache); };
+
+    for (int i = 1; i < argc; i++) {
+        exhaustive = exhaustive || std::string(argv[i]) == "--exhaustive";
+    }
+
+    // One pool for the whole run (or the lifetime of a service), started on first use
+    std::unique_ptr<EquationPool> pool;
+    auto get_pool = [&pool]() -> EquationPool& {
+        if (!pool) {
+            pool = std::make_unique<EquationPool>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        return *pool;
+    };
+
+    // Each query only checks its own part's operator set
+    int status;
+    if (run_service("day7", input_path, argc, argv, load,
+                    [&get_pool, exhaustive](std::deque<Equation>& equations, int part) {
+                        auto [total_no_concat, total] = solve_equations(get_pool(), equations, exhaustive, part);
+                        return std::to_string((part == 1) ? total_no_concat : total);
+                    }, status)) {
+        return status;
+    }
+
+    Benchmark bench("day7", argc, argv);
+
+    std::deque<Equation> equations = bench.phase("parse", [&] { return load(input_path); });
+    auto [total_no_concat, total] = bench.phase("solve", [&] { return solve_equations(get_pool(), equations, exhaustive); });
+
+    std::cout << "Total sum of valid equation results (+, *): " << total_no_concat << std::endl;
+    std::cout << "Total sum of valid equation results (+, *, ||): " << total << std::endl;
 
-    return 0;
+    return bench.finish();
 }
@@ -3,99 +3,807 @@
 #include <fstream>
 #include <string>
 #include <sstream>
-#include <cmath>
+#include <utility>
+#include <unordered_map>
+#include <cstdint>
+#include <bit>
 #include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <span>
 
-using Antinodes = std::vector<std::vector<bool>>;
-using Grid = std::vector<std::string>;
+#include "benchmark.h"
+#include "input_cache.h"
+#include "service.h"
+
+using Coordinate = std::pair<int, int>;
+using AntennaIndex = std::unordered_map<char, std::vector<Coordinate>>;  // frequency -> antenna locations
 
 
 /**
- * @brief Finds the antinodes in a given grid and updates the antinodes vector.
+ * @brief A packed bitset marking antinode locations, stored row-major in 64-bit words.
  * 
- * This function identifies the antinodes in a grid based on the given row and column.
- * An antinode is a point that is linearly spaced from two "antennas" of the same frequency (i.e. matching characters).
- * The function updates the antinodes vector to mark the positions of these antinodes.
- * 
- * @param row The row index in the grid to start the search.
- * @param col The column index in the grid to start the search.
- * @param grid The grid representing the locations of antennas.
- * @param antinodes The vector to be updated with the positions of the antinodes.
- */
-void find_antinodes(int row, int col, Grid& grid, Antinodes& antinodes) {
-    int max_vert = std::floor(grid.size() / 2);
-    int max_hor = std::floor(grid[0].length() / 2);
-    char frequency = grid[row].at(col);
-    int max_row = static_cast<int>(grid.size() - 1);
-    int max_col = static_cast<int>(grid[0].length() - 1);
-
-    int start_row = std::max(row - max_vert, 0);
-    int end_row = std::min(row + max_vert, max_row);
-    int start_col = std::max(col - max_hor, 0);
-    int end_col = std::min(col + max_hor, max_col);
-
-    for (int j = start_row; j <= end_row; j++) {
-        for (int i = start_col; i <= end_col; i++) {
-            char c = grid[j].at(i);
-
-            // If we find another collinear antenna of matching frequency, look for antinodes on either side
-            if (!(j == row && i == col) && c == frequency) {
-                int delta_x = i - col;
-                int delta_y = j - row;
-
-                int new_col = i;
-                int new_row = j;
-
-                while (new_col <= max_col && new_col >= 0 && new_row <= max_row && new_row >= 0) {
-                    antinodes[new_row][new_col] = true;
-                    new_col += delta_x;
-                    new_row += delta_y;
-                }
+ * Rows are not padded, so the whole map is one contiguous bit array and counting is a popcount per word.
+ */
+class AntinodeMap {
+public:
+    /**
+     * @brief Constructs an empty AntinodeMap object.
+     * 
+     * @param rows The number of rows in the grid.
+     * @param cols The number of columns in the grid.
+     */
+    AntinodeMap(int rows, int cols)
+        : rows_(rows), cols_(cols), words_((static_cast<size_t>(rows) * cols + 63) / 64, 0) {}
 
-                new_col = i;
-                new_row = j;
-                while (new_col <= max_col && new_col >= 0 && new_row <= max_row && new_row >= 0) {
-                    antinodes[new_row][new_col] = true;
-                    new_col -= delta_x;
-                    new_row -= delta_y;
-                }
+    /**
+     * @brief Marks a single location as an antinode.
+     */
+    void set(int row, int col) {
+        size_t bit = static_cast<size_t>(row) * cols_ + col;
+        words_[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+
+    /**
+     * @brief Marks every step-th location of a row between two columns (inclusive) as an antinode.
+     * 
+     * Bits landing in the same word are combined into one mask, and a contiguous run (step 1) is written
+     * a whole word at a time.
+     * 
+     * @param row The row to mark.
+     * @param first_col The first column to mark.
+     * @param last_col The last column to mark.
+     * @param step The distance between marked columns (at least 1).
+     */
+    void set_row(int row, int first_col, int last_col, int step) {
+        size_t first = static_cast<size_t>(row) * cols_ + first_col;
+        size_t last = static_cast<size_t>(row) * cols_ + last_col;
+
+        if (step == 1) {
+            size_t first_word = first / 64;
+            size_t last_word = last / 64;
+            uint64_t first_mask = ~uint64_t(0) << (first % 64);
+            uint64_t last_mask = ~uint64_t(0) >> (63 - last % 64);
+
+            if (first_word == last_word) {
+                words_[first_word] |= first_mask & last_mask;
+                return;
             }
+
+            words_[first_word] |= first_mask;
+            std::fill(words_.begin() + first_word + 1, words_.begin() + last_word, ~uint64_t(0));
+            words_[last_word] |= last_mask;
+            return;
+        }
+
+        size_t word = first / 64;
+        uint64_t mask = 0;
+
+        for (size_t bit = first; bit <= last; bit += step) {
+            if (bit / 64 != word) {
+                words_[word] |= mask;
+                word = bit / 64;
+                mask = 0;
+            }
+            mask |= uint64_t(1) << (bit % 64);
+        }
+
+        words_[word] |= mask;
+    }
+
+    /**
+     * @brief Counts the marked locations.
+     */
+    size_t count() const {
+        return count(0, words_.size());
+    }
+
+    /**
+     * @brief Counts the marked locations stored in a range of words.
+     * 
+     * @param first_word The first word to count.
+     * @param last_word One past the last word to count.
+     */
+    size_t count(size_t first_word, size_t last_word) const {
+        size_t cnt = 0;
+        for (size_t w = first_word; w < last_word; w++) {
+            cnt += std::popcount(words_[w]);
+        }
+        return cnt;
+    }
+
+    /**
+     * @brief ORs the marks of another map of the same size into a range of words of this one.
+     * 
+     * @param other The map to merge in.
+     * @param first_word The first word to merge.
+     * @param last_word One past the last word to merge.
+     */
+    void merge(const AntinodeMap& other, size_t first_word, size_t last_word) {
+        for (size_t w = first_word; w < last_word; w++) {
+            words_[w] |= other.words_[w];
         }
     }
+
+    /**
+     * @brief Returns the number of 64-bit words backing the map.
+     */
+    size_t num_words() const {
+        return words_.size();
+    }
+
+    int rows() const {
+        return rows_;
+    }
+
+    int cols() const {
+        return cols_;
+    }
+
+private:
+    int rows_;
+    int cols_;
+    std::vector<uint64_t> words_;
+};
+
+/**
+ * @brief Rounds a division towards negative infinity.
+ */
+int floor_div(int a, int b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
 }
 
 /**
- * @brief Counts the number of unique antinode locations in a grid and prints to console.
+ * @brief Finds the range of k for which start + k * delta stays inside the grid along one axis.
+ * 
+ * @param start The starting coordinate along the axis.
+ * @param delta The step along the axis.
+ * @param size The size of the grid along the axis.
+ * @param k_min Tightened to the smallest valid k.
+ * @param k_max Tightened to the largest valid k.
+ */
+void clip_line(int start, int delta, int size, int& k_min, int& k_max) {
+    if (delta == 0) {
+        return;
+    }
+
+    // 0 <= start + k * delta <= size - 1
+    int lo = (delta > 0) ? -start : start - (size - 1);
+    int hi = (delta > 0) ? size - 1 - start : start;
+    k_min = std::max(k_min, -floor_div(-lo, std::abs(delta)));
+    k_max = std::min(k_max, floor_div(hi, std::abs(delta)));
+}
+
+/**
+ * @brief Calls a function for every grid location on the line through two antennas (spaced like the antennas).
+ * 
+ * @param a The first antenna.
+ * @param b The second antenna.
+ * @param rows The number of rows in the grid.
+ * @param cols The number of columns in the grid.
+ * @param visit Called with (row, col) for each location on the line.
+ */
+template <typename Visit>
+void for_each_on_line(Coordinate a, Coordinate b, int rows, int cols, Visit visit) {
+    if (a == b) {
+        return;  // Two antennas in one place don't define a line
+    }
+
+    int delta_y = b.first - a.first;
+    int delta_x = b.second - a.second;
+
+    int k_min = std::numeric_limits<int>::min();
+    int k_max = std::numeric_limits<int>::max();
+    clip_line(a.first, delta_y, rows, k_min, k_max);
+    clip_line(a.second, delta_x, cols, k_min, k_max);
+
+    for (int k = k_min; k <= k_max; k++) {
+        visit(a.first + k * delta_y, a.second + k * delta_x);
+    }
+}
+
+/**
+ * @brief Marks every grid location on the line through two antennas (spaced like the antennas) as an antinode.
+ * 
+ * @param a The first antenna.
+ * @param b The second antenna.
+ * @param antinodes The map to be updated with the positions of the antinodes.
+ */
+void mark_line(Coordinate a, Coordinate b, AntinodeMap& antinodes) {
+    if (a == b) {
+        return;  // Two antennas in one place don't define a line
+    }
+
+    int delta_y = b.first - a.first;
+    int delta_x = b.second - a.second;
+
+    // A horizontal line is a strided run within one row
+    if (delta_y == 0) {
+        int step = std::abs(delta_x);
+        int first_col = a.second % step;
+        int last_col = first_col + (antinodes.cols() - 1 - first_col) / step * step;
+        antinodes.set_row(a.first, first_col, last_col, step);
+        return;
+    }
+
+    for_each_on_line(a, b, antinodes.rows(), antinodes.cols(), [&](int row, int col) {
+        antinodes.set(row, col);
+    });
+}
+
+/**
+ * @brief Which antinode rules to compute in a run.
+ * 
+ * Plain: the two locations spaced like the antennas on either side of a pair.
+ * Harmonics: every location on the line through a pair, spaced like the antennas (resonant harmonics).
+ */
+enum class AntinodeMode {
+    Plain = 1,
+    Harmonics = 2,
+    Both = 3,
+};
+
+/**
+ * @brief Checks if a mode includes a rule.
+ */
+bool has_mode(AntinodeMode mode, AntinodeMode rule) {
+    return (static_cast<int>(mode) & static_cast<int>(rule)) != 0;
+}
+
+/**
+ * @brief The antinode maps of one run, one per rule (a rule that isn't computed gets an empty map).
+ */
+struct AntinodeMaps {
+    AntinodeMode mode;
+    AntinodeMap plain;
+    AntinodeMap harmonics;
+
+    /**
+     * @brief Constructs empty AntinodeMaps for a grid.
+     * 
+     * @param rows The number of rows in the grid.
+     * @param cols The number of columns in the grid.
+     * @param mode The rules to compute.
+     */
+    AntinodeMaps(int rows, int cols, AntinodeMode mode)
+        : mode(mode),
+          plain(has_mode(mode, AntinodeMode::Plain) ? rows : 0, cols),
+          harmonics(has_mode(mode, AntinodeMode::Harmonics) ? rows : 0, cols) {}
+};
+
+/**
+ * @brief Checks if a location is inside a grid.
+ */
+bool in_grid(int row, int col, int rows, int cols) {
+    return row >= 0 && row < rows && col >= 0 && col < cols;
+}
+
+/**
+ * @brief Marks the antinodes of one antenna pair under every rule of a run.
+ * 
+ * @param a The first antenna.
+ * @param b The second antenna.
+ * @param maps The maps to be updated with the positions of the antinodes.
+ */
+void mark_pair(Coordinate a, Coordinate b, AntinodeMaps& maps) {
+    if (has_mode(maps.mode, AntinodeMode::Plain)) {
+        int rows = maps.plain.rows();
+        int cols = maps.plain.cols();
+        Coordinate before = {2 * a.first - b.first, 2 * a.second - b.second};
+        Coordinate after = {2 * b.first - a.first, 2 * b.second - a.second};
+
+        if (in_grid(before.first, before.second, rows, cols)) {
+            maps.plain.set(before.first, before.second);
+        }
+        if (in_grid(after.first, after.second, rows, cols)) {
+            maps.plain.set(after.first, after.second);
+        }
+    }
+
+    if (has_mode(maps.mode, AntinodeMode::Harmonics)) {
+        mark_line(a, b, maps.harmonics);
+    }
+}
+
+/**
+ * @brief Adds the antennas in one row of the grid to the index, bucketed by frequency.
+ * 
+ * @param row The row index of the line in the grid.
+ * @param line The text of the row.
+ * @param index The index to be updated with the antenna locations.
+ */
+void index_antennas(int row, const std::string& line, AntennaIndex& index) {
+    for (int col = 0; col < static_cast<int>(line.length()); col++) {
+        char c = line[col];
+        if (c != '.') {
+            index[c].push_back({row, col});
+        }
+    }
+}
+
+/**
+ * @brief Finds the antinodes of a single frequency and updates the antinode maps.
+ * 
+ * An antinode is a point that is linearly spaced from two "antennas" of the same frequency (i.e. matching characters).
+ * Every pair of antennas in the frequency's bucket is visited once and marked under every rule of the run, so the
+ * cost depends on the number of pairs rather than the grid area, and computing both rules costs a single pass.
+ * 
+ * @param antennas The locations of all antennas of one frequency.
+ * @param antinodes The maps to be updated with the positions of the antinodes.
+ * @param first The first antenna to pair with the ones after it (to split a frequency into chunks).
+ * @param last One past the last antenna to pair with the ones after it.
+ */
+void find_antinodes(const std::vector<Coordinate>& antennas, AntinodeMaps& antinodes,
+                    size_t first = 0, size_t last = std::numeric_limits<size_t>::max()) {
+    for (size_t a = first; a < std::min(last, antennas.size()); a++) {
+        for (size_t b = a + 1; b < antennas.size(); b++) {
+            mark_pair(antennas[a], antennas[b], antinodes);
+        }
+    }
+}
+
+/**
+ * @brief Keeps the antinodes of a changing set of antennas up to date, one antenna at a time.
+ * 
+ * Every location holds the number of antenna pairs that make it an antinode (one count per rule), and the number
+ * of locations with a non-zero count is maintained as counts change. Adding or removing an antenna only walks the
+ * pairs it belongs to, so an update costs in proportion to the antenna count of its frequency, not the map size.
+ */
+class AntinodeEngine {
+public:
+    /**
+     * @brief Constructs an AntinodeEngine object for an empty grid.
+     * 
+     * @param rows The number of rows in the grid.
+     * @param cols The number of columns in the grid.
+     * @param mode The rules to keep up to date.
+     */
+    AntinodeEngine(int rows, int cols, AntinodeMode mode)
+        : rows_(rows), cols_(cols), mode_(mode),
+          plain_refs_(has_mode(mode, AntinodeMode::Plain) ? static_cast<size_t>(rows) * cols : 0, 0),
+          harmonic_refs_(has_mode(mode, AntinodeMode::Harmonics) ? static_cast<size_t>(rows) * cols : 0, 0),
+          occupants_(static_cast<size_t>(rows) * cols, '.'), plain_unique_(0), harmonic_unique_(0) {}
+
+    /**
+     * @brief Adds an antenna, marking the lines through it and every other antenna of its frequency.
+     * 
+     * @param frequency The antenna frequency.
+     * @param pos The antenna location.
+     * @return true If the antenna was added.
+     * @return false If the location is off the grid or already holds an antenna (of any frequency), or the frequency
+     * is '.', which marks empty locations.
+     */
+    bool add_antenna(char frequency, Coordinate pos) {
+        if (frequency == '.' || !in_grid(pos.first, pos.second, rows_, cols_) || occupant(pos) != '.') {
+            return false;
+        }
+
+        std::vector<Coordinate>& antennas = index_[frequency];
+        for (const Coordinate& other : antennas) {
+            update_pair(pos, other, 1);
+        }
+
+        antennas.push_back(pos);
+        occupant(pos) = frequency;
+        return true;
+    }
+
+    /**
+     * @brief Removes an antenna, unmarking the lines through it and every other antenna of its frequency.
+     * 
+     * @param frequency The antenna frequency.
+     * @param pos The antenna location.
+     * @return true If the antenna was removed.
+     * @return false If there is no such antenna.
+     */
+    bool remove_antenna(char frequency, Coordinate pos) {
+        if (!in_grid(pos.first, pos.second, rows_, cols_) || occupant(pos) != frequency) {
+            return false;
+        }
+
+        auto bucket = index_.find(frequency);
+        if (bucket == index_.end()) {
+            return false;
+        }
+
+        std::vector<Coordinate>& antennas = bucket->second;
+        auto it = std::find(antennas.begin(), antennas.end(), pos);
+        if (it == antennas.end()) {
+            return false;
+        }
+
+        *it = antennas.back();
+        antennas.pop_back();
+        occupant(pos) = '.';
+
+        for (const Coordinate& other : antennas) {
+            update_pair(pos, other, -1);
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of unique antinode locations under the plain rule.
+     */
+    size_t count_plain() const {
+        return plain_unique_;
+    }
+
+    /**
+     * @brief Returns the number of unique antinode locations under the resonant harmonics rule.
+     */
+    size_t count_harmonics() const {
+        return harmonic_unique_;
+    }
+
+    AntinodeMode mode() const {
+        return mode_;
+    }
+
+private:
+    char& occupant(Coordinate pos) {
+        return occupants_[static_cast<size_t>(pos.first) * cols_ + pos.second];
+    }
+
+    void update_pair(Coordinate a, Coordinate b, int change) {
+        if (has_mode(mode_, AntinodeMode::Plain)) {
+            update_location(plain_refs_, plain_unique_, 2 * a.first - b.first, 2 * a.second - b.second, change);
+            update_location(plain_refs_, plain_unique_, 2 * b.first - a.first, 2 * b.second - a.second, change);
+        }
+
+        if (has_mode(mode_, AntinodeMode::Harmonics)) {
+            for_each_on_line(a, b, rows_, cols_, [&](int row, int col) {
+                update_location(harmonic_refs_, harmonic_unique_, row, col, change);
+            });
+        }
+    }
+
+    void update_location(std::vector<uint32_t>& refs, size_t& unique, int row, int col, int change) {
+        if (!in_grid(row, col, rows_, cols_)) {
+            return;
+        }
+
+        uint32_t& cnt = refs[static_cast<size_t>(row) * cols_ + col];
+
+        if (change > 0 && cnt++ == 0) {
+            unique++;
+        } else if (change < 0 && --cnt == 0) {
+            unique--;
+        }
+    }
+
+    int rows_;
+    int cols_;
+    AntinodeMode mode_;
+    AntennaIndex index_;
+    std::vector<uint32_t> plain_refs_;     // Per location, the number of antenna pairs making it a plain antinode
+    std::vector<uint32_t> harmonic_refs_;  // Per location, the number of antenna pairs whose line passes through it
+    std::vector<char> occupants_;          // Per location, the frequency of the antenna there ('.' if none)
+    size_t plain_unique_;
+    size_t harmonic_unique_;
+};
+
+/**
+ * @brief Prints the antinode counts of every rule in a run.
+ * 
+ * @param mode The rules that were computed.
+ * @param plain_cnt The number of unique antinodes under the plain rule.
+ * @param harmonics_cnt The number of unique antinodes under the resonant harmonics rule.
  */
-int main() {
-    std::ifstream file("../data/day8.txt");
+void print_counts(AntinodeMode mode, size_t plain_cnt, size_t harmonics_cnt) {
+    if (has_mode(mode, AntinodeMode::Plain)) {
+        std::cout << "Total number of unique antinodes: " << plain_cnt << std::endl;
+    }
+    if (has_mode(mode, AntinodeMode::Harmonics)) {
+        std::cout << "Total number of unique antinodes with resonant harmonics: " << harmonics_cnt << std::endl;
+    }
+}
+
+/**
+ * @brief Replays antenna moves from a file on an AntinodeEngine, printing the antinode count after each one.
+ * 
+ * Each line is either "+ <frequency> <row> <col>" to add an antenna or "- <frequency> <row> <col>" to remove one.
+ * Moves that can't be applied (adding onto an occupied or off-grid location, removing a missing antenna) are reported
+ * and skipped.
+ * 
+ * @param engine The engine holding the current antennas.
+ * @param moves_path The path to the moves file.
+ */
+void replay_moves(AntinodeEngine& engine, const std::string& moves_path) {
+    std::ifstream file(moves_path);
     std::string line;
-    Grid grid;
-    Antinodes antinodes;
-    
+
     while (std::getline(file, line)) {
-        grid.push_back(line);
-        std::vector<bool> new_vec(line.length(), false);
-        antinodes.push_back(new_vec);
+        std::istringstream iss(line);
+        char action;
+        char frequency;
+        Coordinate pos;
+
+        if (!(iss >> action >> frequency >> pos.first >> pos.second)) {
+            continue;
+        }
+
+        if (action == '+' && !engine.add_antenna(frequency, pos)) {
+            std::cout << "Can't add antenna " << frequency << " at " << pos.first << "," << pos.second << std::endl;
+        } else if (action == '-' && !engine.remove_antenna(frequency, pos)) {
+            std::cout << "No antenna " << frequency << " at " << pos.first << "," << pos.second << std::endl;
+        }
+
+        std::cout << line << std::endl;
+        print_counts(engine.mode(), engine.count_plain(), engine.count_harmonics());
     }
+}
 
-    for (int i = 0; i < grid.size(); i++) {
-        for (int j = 0; j < line.length(); j++) {
-            char c = grid[i].at(j);
-            if (c != '.') {
-                find_antinodes(i, j, grid, antinodes);
+/**
+ * @brief A chunk of antenna pairs: every antenna in [first, last) paired with each antenna after it.
+ */
+struct PairChunk {
+    const std::vector<Coordinate>* antennas;
+    size_t first;
+    size_t last;
+};
+
+/**
+ * @brief Finds the antinodes of every frequency in parallel and returns the merged maps.
+ * 
+ * Each frequency is a work item, except that a frequency holding more than its share of all antenna pairs is
+ * split into chunks of roughly equal pair counts. Threads mark antinodes in their own map, and the maps are then
+ * OR-reduced in parallel, with each thread merging a contiguous range of words.
+ * 
+ * @param index The antennas, bucketed by frequency.
+ * @param rows The number of rows in the grid.
+ * @param cols The number of columns in the grid.
+ * @param mode The rules to compute.
+ * @param num_threads The number of threads to use.
+ * @return AntinodeMaps The positions of the antinodes.
+ */
+AntinodeMaps find_antinodes_parallel(const AntennaIndex& index, int rows, int cols, AntinodeMode mode, unsigned int num_threads) {
+    size_t total_pairs = 0;
+    for (const auto& [frequency, antennas] : index) {
+        total_pairs += antennas.size() * (antennas.size() - 1) / 2;
+    }
+
+    // Split dominant frequencies so no single work item holds more than a thread's share of pairs
+    size_t chunk_pairs = std::max<size_t>(1, total_pairs / (num_threads * 4));
+    std::vector<PairChunk> chunks;
+
+    for (const auto& [frequency, antennas] : index) {
+        size_t first = 0;
+        size_t pairs = 0;
+
+        for (size_t a = 0; a < antennas.size(); a++) {
+            pairs += antennas.size() - 1 - a;
+            if (pairs >= chunk_pairs || a + 1 == antennas.size()) {
+                chunks.push_back({&antennas, first, a + 1});
+                first = a + 1;
+                pairs = 0;
             }
         }
     }
 
-    unsigned int cnt = 0;
-    for (auto& row : antinodes) {
-        for (bool is_antinode : row) {
-            if (is_antinode) {
-                cnt++;
+    std::vector<AntinodeMaps> thread_maps(num_threads, AntinodeMaps(rows, cols, mode));
+    std::atomic<size_t> next_chunk = 0;
+    std::vector<std::thread> workers;
+
+    for (unsigned int t = 0; t < num_threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (size_t k = next_chunk++; k < chunks.size(); k = next_chunk++) {
+                find_antinodes(*chunks[k].antennas, thread_maps[t], chunks[k].first, chunks[k].last);
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    // OR-reduce into the first map, each thread taking its own range of words
+    for (unsigned int t = 0; t < num_threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (AntinodeMap AntinodeMaps::*map : {&AntinodeMaps::plain, &AntinodeMaps::harmonics}) {
+                size_t num_words = (thread_maps[0].*map).num_words();
+                size_t words_per_thread = (num_words + num_threads - 1) / num_threads;
+                size_t first_word = std::min(num_words, t * words_per_thread);
+                size_t last_word = std::min(num_words, first_word + words_per_thread);
+
+                for (unsigned int other = 1; other < num_threads; other++) {
+                    (thread_maps[0].*map).merge(thread_maps[other].*map, first_word, last_word);
+                }
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return std::move(thread_maps[0]);
+}
+
+/**
+ * @brief The parsed puzzle input: the antennas bucketed by frequency, and the grid size.
+ */
+struct AntennaMap {
+    AntennaIndex index;
+    int rows = 0;
+    int cols = 0;
+};
+
+/**
+ * @brief Reads the antenna grid from a file, building the antenna index in the same pass.
+ * 
+ * @param path The path to the input file.
+ * @return AntennaMap The antennas and grid size.
+ */
+AntennaMap read_antennas(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    AntennaMap map;
+
+    while (std::getline(file, line)) {
+        index_antennas(map.rows, line, map.index);
+        map.cols = std::max(map.cols, static_cast<int>(line.length()));
+        map.rows++;
+    }
+
+    return map;
+}
+
+/**
+ * @brief Loads the antennas from the binary cache, or parses the text and writes the cache (see input_cache.h).
+ * 
+ * The cache holds the grid size, the frequencies, and the antenna coordinates of each frequency CSR-style (as flat
+ * row, column pairs), so the antenna index is rebuilt without scanning the grid.
+ * 
+ * @param path The path to the input file.
+ * @param use_cache False to always parse the text.
+ * @return AntennaMap The antennas and grid size.
+ */
+AntennaMap load_antennas(const std::string& path, bool use_cache) {
+    return load_cached(path, "day8", use_cache, read_antennas,
+                       [](const AntennaMap& map, CacheWriter& writer) {
+                           std::vector<char> frequencies;
+                           std::vector<std::vector<int>> coordinates;
+
+                           for (const auto& [frequency, antennas] : map.index) {
+                               frequencies.push_back(frequency);
+                               std::vector<int>& flat = coordinates.emplace_back();
+                               for (const Coordinate& pos : antennas) {
+                                   flat.push_back(pos.first);
+                                   flat.push_back(pos.second);
+                               }
+                           }
+
+                           writer.put<int32_t>(map.rows);
+                           writer.put<int32_t>(map.cols);
+                           writer.put_array(frequencies);
+                           writer.put_lists(coordinates);
+                       },
+                       [](CacheReader& reader) {
+                           AntennaMap map;
+                           map.rows = reader.get<int32_t>();
+                           map.cols = reader.get<int32_t>();
+                           std::span<const char> frequencies = reader.get_array<char>();
+                           size_t k = 0;
+
+                           reader.get_lists<int>([&](std::span<const int> flat) {
+                               if (k < frequencies.size() && flat.size() % 2 == 0) {
+                                   std::vector<Coordinate>& antennas = map.index[frequencies[k]];
+                                   for (size_t i = 0; i < flat.size(); i += 2) {
+                                       antennas.push_back({flat[i], flat[i + 1]});
+                                   }
+                               } else {
+                                   reader.fail();
+                               }
+                               k++;
+                           });
+
+                           // One coordinate list per frequency, or the cache is rebuilt from the text
+                           if (k != frequencies.size()) {
+                               reader.fail();
+                           }
+                           return map;
+                       });
+}
+
+/**
+ * @brief Finds the antinodes of every frequency, serially or with one thread per group of frequencies.
+ * 
+ * @param map The antennas and grid size.
+ * @param mode Which antinode rules to apply.
+ * @param parallel Whether to process frequencies on separate threads.
+ * @return AntinodeMaps The antinodes under the requested rules.
+ */
+AntinodeMaps compute_antinodes(const AntennaMap& map, AntinodeMode mode, bool parallel) {
+    if (parallel) {
+        unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+        return find_antinodes_parallel(map.index, map.rows, map.cols, mode, num_threads);
+    }
+
+    AntinodeMaps antinodes(map.rows, map.cols, mode);
+
+    for (const auto& [frequency, antennas] : map.index) {
+        find_antinodes(antennas, antinodes);
+    }
+
+    return antinodes;
+}
+
+/**
+ * @brief Counts the number of unique antinode locations in a grid and prints to console.
+ * 
+ * Pass --mode plain|harmonics|both to pick the antinode rules (both by default), --parallel to process frequencies
+ * on separate threads, or --moves <file> to then replay antenna moves incrementally with an AntinodeEngine.
+ * Pass --bench to time each phase (see benchmark.h), or --serve / --query to keep the antennas loaded in a resident
+ * service (see service.h). Parsed antennas are cached next to the input (see input_cache.h); pass --no-cache to
+ * always parse the text.
+ */
+int main(int argc, char* argv[]) {
+    const std::string input_path = "../data/day8.txt";
+    bool use_cache = cache_enabled(argc, argv);
+    auto load = [use_cache](const std::string& path) { return load_antennas(path, use_cache); };
+    bool parallel = false;
+    std::string moves_path;
+    AntinodeMode mode = AntinodeMode::Both;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        parallel = parallel || arg == "--parallel";
+        if (arg == "--moves" && i + 1 < argc) {
+            moves_path = argv[++i];
+        } else if (arg == "--mode" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "plain") {
+                mode = AntinodeMode::Plain;
+            } else if (name == "harmonics") {
+                mode = AntinodeMode::Harmonics;
+            } else if (name == "both") {
+                mode = AntinodeMode::Both;
+            } else {
+                std::cerr << "Unknown mode '" << name << "' (expected plain, harmonics or both)" << std::endl;
+                return 1;
             }
         }
     }
 
-    std::cout << "Total number of unique antinodes: " << cnt << std::endl;
-}
\ No newline at end of file
+    // Part one counts plain antinodes, part two counts them with resonant harmonics
+    int status;
+    if (run_service("day8", input_path, argc, argv, load,
+                    [parallel](AntennaMap& map, int part) {
+                        AntinodeMaps antinodes = compute_antinodes(map, (part == 1) ? AntinodeMode::Plain : AntinodeMode::Harmonics, parallel);
+                        return std::to_string((part == 1) ? antinodes.plain.count() : antinodes.harmonics.count());
+                    }, status)) {
+        return status;
+    }
+
+    Benchmark bench("day8", argc, argv);
+    AntennaMap map = bench.phase("parse", [&] { return load(input_path); });
+
+    if (!moves_path.empty()) {
+        AntinodeEngine engine = bench.phase("engine_build", [&] {
+            AntinodeEngine engine(map.rows, map.cols, mode);
+            for (const auto& [frequency, antennas] : map.index) {
+                for (const Coordinate& pos : antennas) {
+                    engine.add_antenna(frequency, pos);
+                }
+            }
+            return engine;
+        });
+
+        print_counts(mode, engine.count_plain(), engine.count_harmonics());
+        replay_moves(engine, moves_path);
+        return bench.finish();
+    }
+
+    AntinodeMaps antinodes = bench.phase(parallel ? "antinodes_parallel" : "antinodes", [&] {
+        return compute_antinodes(map, mode, parallel);
+    });
+
+    print_counts(mode, antinodes.plain.count(), antinodes.harmonics.count());
+
+    return bench.finish();
+}
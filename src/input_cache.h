@@ -0,0 +1,398 @@
+/**
+ * @file input_cache.h
+ * @brief Binary cache of parsed inputs, written next to the text input and memory-mapped on later runs.
+ *
+ * The first run of a day parses its text input as before and writes the parsed form to "<input>.cache". Later runs
+ * map that file instead and rebuild the parsed input from flat arrays, so no text is parsed. A cache is only used if:
+ * - It starts with the expected magic number, format version and day tag.
+ * - The size and hash (64-bit FNV-1a) it recorded for the text input still match the text on disk.
+ * - Its payload matches the recorded checksum (also FNV-1a), so a corrupted cache is caught too.
+ *
+ * Hashing the text means mapping and reading it once, which is still far cheaper than parsing it.
+ *
+ * Otherwise the text is parsed again and the cache is rewritten. Pass --no-cache to always parse the text.
+ *
+ * The payload is a sequence of values and arrays written by CacheWriter and read back in the same order by
+ * CacheReader. Arrays are stored as an element count followed by the elements, aligned to 8 bytes, so they are read
+ * in place from the mapping. Lists of lists (reports, updates, operands, grid rows) are stored CSR-style, as an
+ * offsets array followed by one values array.
+ */
+#ifndef INPUT_CACHE_H
+#define INPUT_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+// Bump whenever the layout of any day's payload changes, so old caches get rebuilt
+constexpr uint32_t cache_version = 2;
+
+/**
+ * @brief Fixed-size header at the start of every cache file.
+ */
+struct CacheHeader {
+    char magic[4];             // "AOCC"
+    uint32_t version;          // cache_version
+    char tag[8];               // The day that wrote the cache, zero padded
+    uint64_t source_size;      // Size of the text input when the cache was written
+    uint64_t source_hash;      // FNV-1a of the text input when the cache was written
+    uint64_t payload_size;     // Bytes following the header
+    uint64_t checksum;         // FNV-1a of the payload
+};
+
+/**
+ * @brief Computes the 64-bit FNV-1a hash of a block of bytes.
+ */
+inline uint64_t fnv1a(const unsigned char* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Returns true unless the program was started with --no-cache.
+ */
+inline bool cache_enabled(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--no-cache") {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Builds the payload of a cache file in memory.
+ */
+class CacheWriter {
+public:
+    /**
+     * @brief Appends a single trivially copyable value.
+     */
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        append(&value, sizeof(T));
+    }
+
+    /**
+     * @brief Appends a contiguous range of trivially copyable values as a count and an aligned array.
+     */
+    template <typename Range>
+    void put_array(const Range& values) {
+        using T = std::ranges::range_value_t<Range>;
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        put<uint64_t>(std::ranges::size(values));
+        align();
+        append(std::ranges::data(values), std::ranges::size(values) * sizeof(T));
+    }
+
+    /**
+     * @brief Appends a range of lists as an offsets array and a values array.
+     *
+     * @param lists The lists (e.g. a vector of vectors, or of strings).
+     * @param proj Maps each element of lists to the contiguous list to store (e.g. a member).
+     */
+    template <typename Lists, typename Proj = std::identity>
+    void put_lists(const Lists& lists, Proj proj = {}) {
+        using List = std::remove_cvref_t<std::invoke_result_t<Proj&, std::ranges::range_reference_t<const Lists>>>;
+        std::vector<uint64_t> offsets = {0};
+        std::vector<std::ranges::range_value_t<List>> values;
+
+        for (const auto& item : lists) {
+            const List& list = std::invoke(proj, item);
+            values.insert(values.end(), std::ranges::begin(list), std::ranges::end(list));
+            offsets.push_back(values.size());
+        }
+
+        put_array(offsets);
+        put_array(values);
+    }
+
+    /**
+     * @brief Writes the header and payload to a cache file, replacing it atomically.
+     *
+     * Failures (e.g. a read-only data directory) are ignored: the input is simply parsed again next time.
+     *
+     * @param cache_path The path of the cache file.
+     * @param tag The day writing the cache.
+     * @param source_size The size of the text input the payload was parsed from.
+     * @param source_hash The FNV-1a hash of that text input.
+     */
+    void save(const std::string& cache_path, std::string_view tag, uint64_t source_size, uint64_t source_hash) const {
+        CacheHeader header = {};
+        std::memcpy(header.magic, "AOCC", 4);
+        header.version = cache_version;
+        std::memcpy(header.tag, tag.data(), std::min(tag.size(), sizeof(header.tag)));
+        header.source_size = source_size;
+        header.source_hash = source_hash;
+        header.payload_size = payload_.size();
+        header.checksum = fnv1a(payload_.data(), payload_.size());
+
+        std::string temp_path = cache_path + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(payload_.data()), payload_.size());
+            if (!file) {
+                std::remove(temp_path.c_str());
+                return;
+            }
+        }
+        std::rename(temp_path.c_str(), cache_path.c_str());
+    }
+
+private:
+    void append(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        payload_.insert(payload_.end(), bytes, bytes + size);
+    }
+
+    void align() {
+        payload_.resize((payload_.size() + 7) / 8 * 8, 0);
+    }
+
+    std::vector<unsigned char> payload_;
+};
+
+/**
+ * @brief Reads values and arrays back from a payload, in the order CacheWriter wrote them.
+ *
+ * Reads past the end of the payload or malformed arrays don't throw; they mark the reader as failed (see ok), and
+ * the caller falls back to parsing the text. Decoders call fail themselves when arrays that belong together (e.g.
+ * one list per result) disagree.
+ */
+class CacheReader {
+public:
+    /**
+     * @brief Constructs a CacheReader object over a payload (which must be 8-byte aligned).
+     */
+    CacheReader(const unsigned char* data, size_t size) : data_(data), size_(size), pos_(0), failed_(false) {}
+
+    /**
+     * @brief Reads a single trivially copyable value.
+     */
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value{};
+
+        if (take(sizeof(T))) {
+            std::memcpy(&value, data_ + pos_ - sizeof(T), sizeof(T));
+        }
+        return value;
+    }
+
+    /**
+     * @brief Returns a view of an array written by CacheWriter::put_array, in place in the payload.
+     */
+    template <typename T>
+    std::span<const T> get_array() {
+        uint64_t count = get<uint64_t>();
+        pos_ = std::min(size_, (pos_ + 7) / 8 * 8);
+
+        if (failed_ || count > (size_ - pos_) / sizeof(T)) {
+            failed_ = true;
+            return {};
+        }
+
+        const T* values = reinterpret_cast<const T*>(data_ + pos_);
+        pos_ += count * sizeof(T);
+        return {values, count};
+    }
+
+    /**
+     * @brief Reads lists written by CacheWriter::put_lists, passing each one to a callback as a span.
+     *
+     * @param each Called as each(std::span<const T> list), in the order the lists were written.
+     */
+    template <typename T, typename F>
+    void get_lists(F each) {
+        std::span<const uint64_t> offsets = get_array<uint64_t>();
+        std::span<const T> values = get_array<T>();
+
+        if (failed_ || offsets.empty() || offsets.back() != values.size()) {
+            failed_ = true;
+            return;
+        }
+
+        // Check every offset before handing out any list, so a bad offset can't make a span past the payload
+        for (size_t i = 0; i + 1 < offsets.size(); i++) {
+            if (offsets[i] > offsets[i + 1]) {
+                failed_ = true;
+                return;
+            }
+        }
+
+        for (size_t i = 0; i + 1 < offsets.size(); i++) {
+            each(values.subspan(offsets[i], offsets[i + 1] - offsets[i]));
+        }
+    }
+
+    /**
+     * @brief Marks the reader as failed, for decoders that find the arrays they read don't fit together.
+     */
+    void fail() {
+        failed_ = true;
+    }
+
+    /**
+     * @brief Returns true if every read succeeded and the whole payload was consumed.
+     */
+    bool ok() const {
+        return !failed_ && pos_ == size_;
+    }
+
+private:
+    bool take(size_t size) {
+        if (failed_ || size > size_ - pos_) {
+            failed_ = true;
+            return false;
+        }
+        pos_ += size;
+        return true;
+    }
+
+    const unsigned char* data_;
+    size_t size_;
+    size_t pos_;
+    bool failed_;
+};
+
+/**
+ * @brief A read-only memory mapping of a whole file, unmapped on destruction.
+ */
+class MappedFile {
+public:
+    MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = static_cast<const unsigned char*>(data);
+                size_ = info.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (data_) {
+            munmap(const_cast<unsigned char*>(data_), size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const unsigned char* data_;
+    size_t size_;
+};
+
+/**
+ * @brief Checks a mapped cache file against its header, the text input it was built from, and its checksum.
+ */
+inline bool is_valid_cache(const MappedFile& file, std::string_view tag, uint64_t source_size, uint64_t source_hash) {
+    CacheHeader header;
+    char expected_tag[sizeof(header.tag)] = {};
+    std::memcpy(expected_tag, tag.data(), std::min(tag.size(), sizeof(expected_tag)));
+
+    if (file.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    return std::memcmp(header.magic, "AOCC", 4) == 0 &&
+           header.version == cache_version &&
+           std::memcmp(header.tag, expected_tag, sizeof(expected_tag)) == 0 &&
+           header.source_size == source_size &&
+           header.source_hash == source_hash &&
+           header.payload_size == file.size() - sizeof(header) &&
+           header.checksum == fnv1a(file.data() + sizeof(header), header.payload_size);
+}
+
+/**
+ * @brief Loads a day's parsed input from its binary cache, or parses the text input and writes the cache.
+ *
+ * @param source_path The path to the text input.
+ * @param tag The name of the day (e.g. "day7"), stored in the cache so days never read each other's caches.
+ * @param use_cache False to always parse the text (see cache_enabled).
+ * @param parse Parses the text input, as Input(const std::string& path).
+ * @param encode Writes the parsed input, as void(const Input& input, CacheWriter& writer).
+ * @param decode Rebuilds the parsed input, as Input(CacheReader& reader).
+ * @return The parsed input.
+ */
+template <typename Parse, typename Encode, typename Decode>
+auto load_cached(const std::string& source_path, std::string_view tag, bool use_cache, Parse parse, Encode encode, Decode decode) {
+    using Input = decltype(parse(source_path));
+    struct stat source;
+
+    if (!use_cache || stat(source_path.c_str(), &source) != 0) {
+        return parse(source_path);
+    }
+
+    // Hash the text itself, so an edit that keeps the size and modification time still invalidates the cache
+    uint64_t source_size;
+    uint64_t source_hash;
+    {
+        MappedFile text(source_path);
+        if (text.size() != static_cast<uint64_t>(source.st_size)) {
+            return parse(source_path);
+        }
+        source_size = text.size();
+        source_hash = fnv1a(text.data(), text.size());
+    }
+
+    std::string cache_path = source_path + ".cache";
+    {
+        MappedFile file(cache_path);
+        if (is_valid_cache(file, tag, source_size, source_hash)) {
+            CacheReader reader(file.data() + sizeof(CacheHeader), file.size() - sizeof(CacheHeader));
+            Input input = decode(reader);
+            if (reader.ok()) {
+                return input;
+            }
+        }
+    }
+
+    Input input = parse(source_path);
+    CacheWriter writer;
+    encode(input, writer);
+    writer.save(cache_path, tag, source_size, source_hash);
+
+    return input;
+}
+
+#endif
@@ -0,0 +1,333 @@
+/**
+ * @file service.h
+ * @brief Resident solver service: keeps a day's parsed input in memory and answers queries over a Unix socket.
+ *
+ * Started with --serve, a day loads its input once and then waits for queries on a Unix domain socket
+ * (/tmp/aoc2024-<day>.sock unless --socket <path> is given). Each connection sends one request line and gets one
+ * reply line back:
+ * - "1" or "2": The answer to that part, computed from the cached input.
+ * - "stop": Shuts the service down.
+ *
+ * Before answering, the service checks the input file's modification time and re-parses it if it changed, so
+ * answers never go stale. Started with --query <request>, a day instead sends the request to a running service and
+ * prints the reply.
+ *
+ * Requests are answered one at a time, so a client that doesn't send its line within service_timeout_s seconds is
+ * dropped. A service refuses to start on a socket path another service is still listening on, and checks that before
+ * loading its input.
+ */
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+// A client gets this long to send its request, so a stalled client can't block the service for long
+constexpr int service_timeout_s = 2;
+
+// Longest request line read from a client
+constexpr size_t max_request_length = 256;
+
+// Pause after accept fails for lack of descriptors or memory, so the service waits instead of spinning
+constexpr int accept_backoff_ms = 100;
+
+/**
+ * @brief Returns the modification time of a file in nanoseconds, or -1 if it can't be read.
+ */
+inline long long file_mtime_ns(const std::string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return -1;
+    }
+    return static_cast<long long>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Opens a Unix domain socket address for a path.
+ *
+ * @param socket_path The path of the socket file.
+ * @param address Filled in with the address.
+ * @return bool False if the path is too long for a socket address.
+ */
+inline bool make_socket_address(const std::string& socket_path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return true;
+}
+
+/**
+ * @brief Checks whether a service is already accepting connections at an address.
+ */
+inline bool is_socket_live(const sockaddr_un& address) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = (probe >= 0 && connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+
+    if (probe >= 0) {
+        close(probe);
+    }
+    return live;
+}
+
+/**
+ * @brief Reads one newline-terminated line from a socket (without the newline).
+ *
+ * Reads in blocks and stops at the first newline, when the peer closes the connection or times out, or after
+ * max_length bytes (the line is cut short there).
+ *
+ * @param fd The connected socket.
+ * @param max_length The longest line to read.
+ * @return std::string The line read so far.
+ */
+inline std::string read_socket_line(int fd, size_t max_length = max_request_length) {
+    std::string line;
+    char buffer[256];
+
+    while (line.size() < max_length) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+
+        size_t start = line.size();
+        line.append(buffer, n);
+
+        size_t end = line.find('\n', start);
+        if (end != std::string::npos) {
+            line.resize(end);
+            break;
+        }
+    }
+
+    if (line.size() > max_length) {
+        line.resize(max_length);
+    }
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+
+    return line;
+}
+
+/**
+ * @brief Writes a whole string to a socket.
+ */
+inline void write_socket(int fd, const std::string& text) {
+    size_t written = 0;
+
+    while (written < text.size()) {
+        ssize_t n = send(fd, text.data() + written, text.size() - written, MSG_NOSIGNAL);  // No SIGPIPE if the peer left
+        if (n <= 0) {
+            return;
+        }
+        written += n;
+    }
+}
+
+/**
+ * @brief Keeps a day's parsed input in memory and answers part queries over a Unix domain socket.
+ *
+ * @tparam Input The parsed input (e.g. a grid, rule maps or lists).
+ * @tparam Load Callable as Input(const std::string& path).
+ * @tparam Solve Callable as std::string(Input& input, int part).
+ */
+template <typename Input, typename Load, typename Solve>
+class SolverService {
+public:
+    /**
+     * @brief Constructs a SolverService object and loads the input.
+     *
+     * @param input_path The path to the day's input file.
+     * @param load Parses the input file.
+     * @param solve Computes the answer to one part from the parsed input.
+     */
+    SolverService(std::string input_path, Load load, Solve solve)
+        : input_path_(std::move(input_path)), load_(load), solve_(solve),
+          mtime_ns_(file_mtime_ns(input_path_)), input_(load_(input_path_)) {}
+
+    /**
+     * @brief Answers queries until a "stop" request arrives.
+     *
+     * @param socket_path The path of the socket file to listen on (replaced if it exists, so check is_socket_live
+     * first, as run_service does).
+     * @return int Exit status: 1 if the socket couldn't be set up or accepting connections failed, 0 otherwise.
+     */
+    int serve(const std::string& socket_path) {
+        sockaddr_un address;
+        if (!make_socket_address(socket_path, address)) {
+            std::cerr << "Socket path too long: " << socket_path << std::endl;
+            return 1;
+        }
+
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(socket_path.c_str());  // Left behind by a service that didn't shut down cleanly
+
+        if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(server, 16) != 0) {
+            std::cerr << "Could not listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+
+        std::cout << "Serving " << input_path_ << " on " << socket_path << std::endl;
+        bool running = true;
+        int status = 0;
+
+        while (running) {
+            int client = accept(server, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+
+                std::cerr << "Could not accept a connection on " << socket_path << ": " << std::strerror(errno) << std::endl;
+                if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(accept_backoff_ms));
+                    continue;
+                }
+
+                status = 1;
+                break;
+            }
+
+            timeval timeout = {service_timeout_s, 0};
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+            std::string request = read_socket_line(client);
+
+            if (request.empty()) {
+                // Nothing sent (e.g. a liveness probe, or a client that timed out)
+            } else if (request == "stop") {
+                write_socket(client, "stopping\n");
+                running = false;
+            } else if (request == "1" || request == "2") {
+                refresh();
+                write_socket(client, solve_(input_, std::stoi(request)) + "\n");
+            } else {
+                write_socket(client, "error: unknown request '" + request + "'\n");
+            }
+
+            close(client);
+        }
+
+        close(server);
+        unlink(socket_path.c_str());
+
+        return status;
+    }
+
+private:
+    /**
+     * @brief Re-parses the input if the file changed since it was loaded.
+     */
+    void refresh() {
+        long long mtime_ns = file_mtime_ns(input_path_);
+
+        if (mtime_ns != mtime_ns_) {
+            input_ = load_(input_path_);
+            mtime_ns_ = mtime_ns;
+        }
+    }
+
+    std::string input_path_;
+    Load load_;
+    Solve solve_;
+    long long mtime_ns_;
+    Input input_;
+};
+
+/**
+ * @brief Sends one request to a running service and prints its reply.
+ *
+ * @param socket_path The path of the service's socket file.
+ * @param request The request line (e.g. "1", "2" or "stop").
+ * @return int Exit status: 1 if the service couldn't be reached, 0 otherwise.
+ */
+inline int query_service(const std::string& socket_path, const std::string& request) {
+    sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0 || !make_socket_address(socket_path, address) ||
+        connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Could not connect to " << socket_path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+
+    write_socket(fd, request + "\n");
+    std::cout << read_socket_line(fd) << std::endl;
+    close(fd);
+
+    return 0;
+}
+
+/**
+ * @brief Handles the --serve, --query and --socket options for a day, if present.
+ *
+ * @param day The name of the day (e.g. "day6"), used for the default socket path.
+ * @param input_path The path to the day's input file.
+ * @param argc The argument count passed to main.
+ * @param argv The arguments passed to main.
+ * @param load Parses the input file, as Input(const std::string& path).
+ * @param solve Computes the answer to one part, as std::string(Input& input, int part).
+ * @param status Set to the exit status when a service option was handled.
+ * @return true If the program ran as a service or client (main should return status).
+ * @return false If no service option was given.
+ */
+template <typename Load, typename Solve>
+bool run_service(const std::string& day, const std::string& input_path, int argc, char* argv[], Load load, Solve solve, int& status) {
+    std::string socket_path = "/tmp/aoc2024-" + day + ".sock";
+    std::string request;
+    bool serve = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--serve") {
+            serve = true;
+        } else if (arg == "--query" && i + 1 < argc) {
+            request = argv[++i];
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        }
+    }
+
+    if (serve) {
+        // Check before loading, so a second --serve doesn't parse the whole input only to give up
+        sockaddr_un address;
+        if (make_socket_address(socket_path, address) && is_socket_live(address)) {
+            std::cerr << "A service is already listening on " << socket_path << std::endl;
+            status = 1;
+            return true;
+        }
+
+        using Input = decltype(load(input_path));
+        SolverService<Input, Load, Solve> service(input_path, load, solve);
+        status = service.serve(socket_path);
+        return true;
+    }
+
+    if (!request.empty()) {
+        status = query_service(socket_path, request);
+        return true;
+    }
+
+    return false;
+}
+
+#endif